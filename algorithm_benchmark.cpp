@@ -0,0 +1,139 @@
+// Benchmark of the maxflow algorithms of Graph (see set_algorithm() in
+// graph.h), and of the schedules of the active nodes of BK (the 'schedule'
+// template argument), on a grid and on a graph with long-range edges.
+//
+// The grid is a binary denoising problem of the kind solved by test.cpp (see
+// benchmark_grids.h). The other graph stands for a superpixel
+// adjacency graph: every node has half of its edges to nodes with close ids
+// and the other half to random nodes, with random capacities. Both graphs
+// are solved with each algorithm and with BK under each schedule; the solve
+// time, the flow and the number of nodes whose segment differs from the one
+// of BK are printed.
+//
+// usage: algorithm_benchmark [side [smoothness [nodes [degree]]]]
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#include "maxflow-v3.03.src/graph.h"
+#include "benchmark_grids.h"
+
+typedef Graph<int, int, int, GRAPH_INDICES> GraphType;
+
+#ifdef MAXFLOW_STATS
+template <typename G> void print_stats( G *g )
+{
+    printf("  (%lld augmentations, %lld orphans)", g->get_stats().augmentations, g->get_stats().orphans);
+}
+#else
+template <typename G> void print_stats( G * ) {}
+#endif
+
+template <int schedule>
+Graph<int, int, int, GRAPH_INDICES, schedule> *make_grid_graph( int side, int smoothness )
+{
+    const std::vector<unsigned char> image = make_noisy_image(side, side, 0.2);
+    const int N = side * side;
+    const int data = 10;
+    Graph<int, int, int, GRAPH_INDICES, schedule> *g = new Graph<int, int, int, GRAPH_INDICES, schedule>(N, 2 * N);
+    add_denoising_grid(g, image, side, side, data, smoothness);
+    return g;
+}
+
+template <int schedule>
+Graph<int, int, int, GRAPH_INDICES, schedule> *make_long_range_graph( int N, int degree )
+{
+    Graph<int, int, int, GRAPH_INDICES, schedule> *g = new Graph<int, int, int, GRAPH_INDICES, schedule>(N, N * degree);
+    g->add_node(N);
+    srand(7);
+    for ( int n = 0; n < N; n++ )
+    {
+        const int v = rand() % 100;
+        g->add_tweights( n, v < 50 ? rand() % 100 : 0, v >= 50 ? rand() % 100 : 0 );
+    }
+    for ( int n = 0; n < N; n++ )
+    {
+        for ( int d = 0; d < degree; d++ )
+        {
+            const int m = d < degree / 2 ? (n + 1 + rand() % 50) % N : rand() % N;
+            const int c = 1 + rand() % 30;
+            if ( m != n ) g->add_edge( n, m, c, c );
+        }
+    }
+    return g;
+}
+
+template <int schedule>
+Graph<int, int, int, GRAPH_INDICES, schedule> *make_graph( bool grid, int a, int b )
+{
+    return grid ? make_grid_graph<schedule>(a, b) : make_long_range_graph<schedule>(a, b);
+}
+
+// Solve g and print the results; the segments of the first graph solved
+// are the reference of the others.
+template <typename G>
+void solve( const char *name, G *g, std::vector<char> &reference )
+{
+    const bool first = reference.empty();
+    clock_t t0 = clock();
+    const int flow = g->maxflow();
+    clock_t t1 = clock();
+
+    int differ = 0;
+    for ( int n = 0; n < g->get_node_num(); n++ )
+    {
+        const char segment = (char)g->what_segment(n);
+        if ( first ) reference.push_back(segment);
+        else if ( segment != reference[n] ) differ++;
+    }
+    printf("  %-13s flow %d  solve %.2f s  %d nodes in another segment than with BK",
+           name, flow, double(t1 - t0) / CLOCKS_PER_SEC, differ);
+    print_stats(g);
+    printf("\n");
+    delete g;
+}
+
+void run( const char *name, bool grid, int a, int b )
+{
+    const GraphType::algotype algorithms[] = { GraphType::BK, GraphType::HPF, GraphType::IBFS };
+    const char *names[] = { "BK", "HPF", "IBFS" };
+    std::vector<char> reference;
+
+    printf("%s\n", name);
+    for ( int k = 0; k < 3; k++ )
+    {
+        GraphType *g = make_graph<GRAPH_FIFO>(grid, a, b);
+        g->set_algorithm(algorithms[k]);
+        solve(names[k], g, reference);
+    }
+    solve("BK, LIFO", make_graph<GRAPH_LIFO>(grid, a, b), reference);
+    solve("BK, distance", make_graph<GRAPH_DISTANCE>(grid, a, b), reference);
+    solve("BK, alternate", make_graph<GRAPH_ALTERNATE>(grid, a, b), reference);
+}
+
+int main( int argc, char **argv )
+{
+    int side = 2000;
+    int smoothness = 8;
+    int nodes = 100000;
+    int degree = 20;
+    if ( argc >= 2 ) side = atoi(argv[1]);
+    if ( argc >= 3 ) smoothness = atoi(argv[2]);
+    if ( argc >= 4 ) nodes = atoi(argv[3]);
+    if ( argc >= 5 ) degree = atoi(argv[4]);
+    if ( side <= 0 || nodes <= 0 || degree <= 0 )
+    {
+        fprintf(stderr, "usage: %s [side [smoothness [nodes [degree]]]]\n", argv[0]);
+        return 1;
+    }
+
+    char name[128];
+    sprintf(name, "%d x %d grid, smoothness %d", side, side, smoothness);
+    run(name, true, side, smoothness);
+    sprintf(name, "%d nodes, degree %d, half of the edges long-range", nodes, degree);
+    run(name, false, nodes, degree);
+
+    return 0;
+}
@@ -0,0 +1,336 @@
+// Benchmark of Graph (see graph.h) and GridGraph (see gridgraph.h) on binary
+// denoising grids, for regression checks.
+//
+// For every instantiation of instances.inc (every type of Graph in each
+// layout, and every type of GridGraph), grid size, noise level, smoothness
+// and connectivity (GridGraph is 4-connected only), the graph is built from
+// a noisy image of disks (see benchmark_grids.h), solved, and its
+// segmentation is read with what_segment(); then 0.1% of the pixels are
+// flipped (with edit_tweights(), or add_tweights() and mark_node() for a
+// GridGraph) and the graph is solved again with reuse_trees. The time of
+// each step is printed in ms and in ns per node, with the memory of the
+// graph (get_memory_size()) and the peak resident memory of the case, one
+// line (CSV) or one object (JSON) per case. The cases go by increasing grid
+// size.
+//
+// On Unix every case runs in a child process of its own, so that its peak
+// resident memory is not the one of the cases before it; elsewhere the
+// cases run in the process and the peak resident memory is -1.
+//
+// usage: benchmark [csv|json] [max_side]
+//
+// The sides of the grids are 64, 256, 1024, 4096 and 8192, up to max_side
+// (2048 by default).
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#include "maxflow-v3.03.src/graph.h"
+#include "maxflow-v3.03.src/gridgraph.h"
+#include "benchmark_grids.h"
+
+#ifdef __unix__
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+// Peak resident memory of the process in kB, or -1 if unknown.
+long peak_rss_kb()
+{
+#ifdef __unix__
+    rusage usage;
+    if ( getrusage(RUSAGE_SELF, &usage) == 0 ) return usage.ru_maxrss;
+#endif
+    return -1;
+}
+
+typedef std::chrono::steady_clock clock_type;
+
+double milliseconds( clock_type::time_point from, clock_type::time_point to )
+{
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// What the benchmark needs of a graph that the interfaces of Graph and
+// GridGraph do not share: its allocation, the flip of a pixel between two
+// solves, its number of arcs and its memory.
+template <typename GraphType> struct benchmark_graph;
+
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+struct benchmark_graph< Graph<captype, tcaptype, flowtype, layout> >
+{
+    typedef Graph<captype, tcaptype, flowtype, layout> GraphType;
+    typedef captype cap_type;
+    typedef tcaptype tcap_type;
+
+    static GraphType *allocate( int width, int height, int connectivity )
+    {
+        GraphType *g = new GraphType(width * height, connectivity == 8 ? 4 * width * height : 2 * width * height);
+        g->track_capacities();
+        return g;
+    }
+
+    // t-links 'data' from the source of pixel n become 'data' to the sink, and the other way round
+    static void flip( GraphType *g, int n, bool source, tcaptype data )
+    {
+        g->edit_tweights( n, source ? 0 : data, source ? data : 0 );
+    }
+
+    static int arc_num( GraphType *g ) { return g->get_arc_num(); }
+    static size_t memory_size( GraphType *g ) { return g->get_memory_size(); }
+};
+
+template <typename captype, typename tcaptype, typename flowtype>
+struct benchmark_graph< GridGraph<captype, tcaptype, flowtype> >
+{
+    typedef GridGraph<captype, tcaptype, flowtype> GraphType;
+    typedef captype cap_type;
+    typedef tcaptype tcap_type;
+
+    static GraphType *allocate( int width, int height, int )
+    {
+        return new GraphType(width, height);
+    }
+
+    static void flip( GraphType *g, int n, bool source, tcaptype data )
+    {
+        g->add_tweights( n, source ? -data : data, source ? data : -data );
+        g->mark_node(n);
+    }
+
+    static int arc_num( GraphType *g ) { return 2 * (g->get_width() * (g->get_height() - 1) + (g->get_width() - 1) * g->get_height()); }
+    static size_t memory_size( GraphType *g ) { return g->get_node_num() * GraphType::get_node_size(); }
+};
+
+struct benchmark_case
+{
+    const char *type;
+    const char *layout;
+    int side;
+    int connectivity;
+    double noise;
+    int smoothness;
+};
+
+struct benchmark_result
+{
+    int nodes, arcs, source_nodes;
+    double flow, resolve_flow;
+    double build_ms, maxflow_ms, segment_ms, resolve_ms;
+    size_t graph_bytes;
+    long peak_rss_kb;
+};
+
+template <typename GraphType>
+benchmark_result run( const benchmark_case &bc, const std::vector<unsigned char> &image )
+{
+    typedef benchmark_graph<GraphType> traits;
+    typedef typename traits::cap_type captype;
+    typedef typename traits::tcap_type tcaptype;
+    const int width = bc.side;
+    const int height = bc.side;
+    const int N = width * height;
+    const tcaptype data = 10;
+    const captype smoothness = (captype)bc.smoothness;
+    // diagonal n-links weigh 1/sqrt(2) of the others (rounded for integer capacities)
+    const captype diagonal = (captype)(bc.smoothness * 0.7071 + (std::numeric_limits<captype>::is_integer ? 0.5 : 0));
+    benchmark_result result;
+
+    clock_type::time_point t0 = clock_type::now();
+    GraphType *g = traits::allocate(width, height, bc.connectivity);
+    add_denoising_grid(g, image, width, height, data, smoothness, bc.connectivity, diagonal);
+    clock_type::time_point t1 = clock_type::now();
+    result.flow = g->maxflow();
+    clock_type::time_point t2 = clock_type::now();
+    result.source_nodes = 0;
+    for ( int n = 0; n < N; n++ )
+    {
+        if ( g->what_segment(n) == GraphType::SOURCE ) result.source_nodes++;
+    }
+    clock_type::time_point t3 = clock_type::now();
+
+    // flip 0.1% of the pixels and solve again from the previous trees
+    // (a pixel drawn twice is flipped back)
+    std::vector<unsigned char> flipped(image);
+    srand(54321);
+    for ( int k = 0; k < N / 1000 + 1; k++ )
+    {
+        const int n = (int)((double)rand() / ((double)RAND_MAX + 1) * N);
+        traits::flip( g, n, flipped[n] != 0, data );
+        flipped[n] = !flipped[n];
+    }
+    clock_type::time_point t4 = clock_type::now();
+    result.resolve_flow = g->maxflow(true);
+    clock_type::time_point t5 = clock_type::now();
+
+    result.nodes = N;
+    result.arcs = traits::arc_num(g);
+    result.build_ms = milliseconds(t0, t1);
+    result.maxflow_ms = milliseconds(t1, t2);
+    result.segment_ms = milliseconds(t2, t3);
+    result.resolve_ms = milliseconds(t4, t5);
+    result.graph_bytes = traits::memory_size(g);
+    result.peak_rss_kb = peak_rss_kb();
+
+    delete g;
+    return result;
+}
+
+// run<GraphType>(bc, image) in a child process, which sends its result back
+// through a pipe.
+template <typename GraphType>
+benchmark_result run_in_child( const benchmark_case &bc, const std::vector<unsigned char> &image )
+{
+#ifdef __unix__
+    int fds[2];
+    if ( pipe(fds) == 0 )
+    {
+        fflush(stdout);
+        const pid_t pid = fork();
+        if ( pid == 0 )
+        {
+            close(fds[0]);
+            const benchmark_result result = run<GraphType>(bc, image);
+            const bool sent = write(fds[1], &result, sizeof(result)) == (ssize_t)sizeof(result);
+            _exit(sent ? 0 : 1);
+        }
+        close(fds[1]);
+        benchmark_result result;
+        const bool received = pid > 0 && read(fds[0], &result, sizeof(result)) == (ssize_t)sizeof(result);
+        close(fds[0]);
+        if ( pid > 0 ) waitpid(pid, NULL, 0);
+        if ( received ) return result;
+    }
+#endif
+    // no child process: the peak resident memory would be the one of all the cases so far
+    benchmark_result result = run<GraphType>(bc, image);
+    result.peak_rss_kb = -1;
+    return result;
+}
+
+void print( bool json, bool first, const benchmark_case &bc, const benchmark_result &r )
+{
+    const double ns = 1e6 / r.nodes; // ns per node of 1 ms
+    if ( json )
+    {
+        printf("%s  {\"type\": \"%s\", \"layout\": \"%s\", \"width\": %d, \"height\": %d, \"connectivity\": %d, \"noise\": %g, \"smoothness\": %d, "
+               "\"nodes\": %d, \"arcs\": %d, \"source_nodes\": %d, \"flow\": %.17g, \"resolve_flow\": %.17g, "
+               "\"build_ms\": %.3f, \"maxflow_ms\": %.3f, \"segment_ms\": %.3f, \"resolve_ms\": %.3f, "
+               "\"build_ns_per_node\": %.2f, \"maxflow_ns_per_node\": %.2f, \"segment_ns_per_node\": %.2f, \"resolve_ns_per_node\": %.2f, "
+               "\"graph_bytes\": %lu, \"peak_rss_kb\": %ld}",
+               first ? "" : ",\n", bc.type, bc.layout, bc.side, bc.side, bc.connectivity, bc.noise, bc.smoothness,
+               r.nodes, r.arcs, r.source_nodes, r.flow, r.resolve_flow,
+               r.build_ms, r.maxflow_ms, r.segment_ms, r.resolve_ms,
+               r.build_ms * ns, r.maxflow_ms * ns, r.segment_ms * ns, r.resolve_ms * ns,
+               (unsigned long)r.graph_bytes, r.peak_rss_kb);
+    }
+    else
+    {
+        if ( first )
+        {
+            printf("type,layout,width,height,connectivity,noise,smoothness,nodes,arcs,source_nodes,flow,resolve_flow,"
+                   "build_ms,maxflow_ms,segment_ms,resolve_ms,"
+                   "build_ns_per_node,maxflow_ns_per_node,segment_ns_per_node,resolve_ns_per_node,graph_bytes,peak_rss_kb\n");
+        }
+        printf("\"%s\",%s,%d,%d,%d,%g,%d,%d,%d,%d,%.17g,%.17g,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.2f,%lu,%ld\n",
+               bc.type, bc.layout, bc.side, bc.side, bc.connectivity, bc.noise, bc.smoothness,
+               r.nodes, r.arcs, r.source_nodes, r.flow, r.resolve_flow,
+               r.build_ms, r.maxflow_ms, r.segment_ms, r.resolve_ms,
+               r.build_ms * ns, r.maxflow_ms * ns, r.segment_ms * ns, r.resolve_ms * ns,
+               (unsigned long)r.graph_bytes, r.peak_rss_kb);
+    }
+    fflush(stdout);
+}
+
+// Run the case bc with every type of Graph of instances.inc in the given layout.
+template <int layout>
+void run_layout( bool json, bool &first, benchmark_case bc, const std::vector<unsigned char> &image )
+{
+    bc.type = "int,int,int";
+    print(json, first, bc, run_in_child< Graph<int, int, int, layout> >(bc, image));
+    first = false;
+    bc.type = "short,int,int";
+    print(json, first, bc, run_in_child< Graph<short, int, int, layout> >(bc, image));
+    bc.type = "unsigned char,short,int";
+    print(json, first, bc, run_in_child< Graph<unsigned char, short, int, layout> >(bc, image));
+    bc.type = "float,float,float";
+    print(json, first, bc, run_in_child< Graph<float, float, float, layout> >(bc, image));
+    bc.type = "double,double,double";
+    print(json, first, bc, run_in_child< Graph<double, double, double, layout> >(bc, image));
+}
+
+// Run the case bc with every type of GridGraph of instances.inc.
+void run_grid_graph( bool json, bool &first, benchmark_case bc, const std::vector<unsigned char> &image )
+{
+    bc.type = "int,int,int";
+    print(json, first, bc, run_in_child< GridGraph<int, int, int> >(bc, image));
+    first = false;
+    bc.type = "short,int,int";
+    print(json, first, bc, run_in_child< GridGraph<short, int, int> >(bc, image));
+    bc.type = "float,float,float";
+    print(json, first, bc, run_in_child< GridGraph<float, float, float> >(bc, image));
+    bc.type = "double,double,double";
+    print(json, first, bc, run_in_child< GridGraph<double, double, double> >(bc, image));
+}
+
+int main( int argc, char **argv )
+{
+    bool json = false;
+    int max_side = 2048;
+    if ( argc >= 2 )
+    {
+        json = strcmp(argv[1], "json") == 0;
+        if ( !json && strcmp(argv[1], "csv") != 0 ) max_side = -1;
+    }
+    if ( argc >= 3 )
+    {
+        max_side = atoi(argv[2]);
+    }
+    if ( max_side < 64 )
+    {
+        fprintf(stderr, "usage: %s [csv|json] [max_side]\n", argv[0]);
+        return 1;
+    }
+
+    const int sides[] = { 64, 256, 1024, 4096, 8192 };
+    const double noises[] = { 0.05, 0.2 };
+    const int smoothnesses[] = { 2, 8 };
+    const int connectivities[] = { 4, 8 };
+
+    bool first = true;
+    if ( json ) printf("[\n");
+    for ( int s = 0; s < 5 && sides[s] <= max_side; s++ )
+    {
+        for ( int k = 0; k < 2; k++ )
+        {
+            const std::vector<unsigned char> image = make_noisy_image(sides[s], sides[s], noises[k]);
+            for ( int m = 0; m < 2; m++ )
+            {
+                for ( int c = 0; c < 2; c++ )
+                {
+                    benchmark_case bc = { "", "", sides[s], connectivities[c], noises[k], smoothnesses[m] };
+
+                    bc.layout = "GRAPH_POINTERS";
+                    run_layout<GRAPH_POINTERS>(json, first, bc, image);
+                    bc.layout = "GRAPH_INDICES";
+                    run_layout<GRAPH_INDICES>(json, first, bc, image);
+                    bc.layout = "GRAPH_INDICES_SPLIT";
+                    run_layout<GRAPH_INDICES_SPLIT>(json, first, bc, image);
+                    if ( connectivities[c] == 4 )
+                    {
+                        bc.layout = "GridGraph";
+                        run_grid_graph(json, first, bc, image);
+                    }
+                }
+            }
+        }
+    }
+    if ( json ) printf("\n]\n");
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+// Denoising grids of the benchmarks (layout_benchmark.cpp, benchmark.cpp and
+// algorithm_benchmark.cpp): a noisy binary image of disks, data terms from
+// the noisy pixels and a constant smoothness term, as in test.cpp.
+//
+// Pixel (x, y) is node y * width + x.
+
+#ifndef BENCHMARK_GRIDS_H
+#define BENCHMARK_GRIDS_H
+
+#include <cstdlib>
+#include <vector>
+
+// Noisy binary image of disks: 1 inside a disk, 0 outside, with a fraction
+// 'noise' of the pixels flipped.
+inline std::vector<unsigned char> make_noisy_image( int width, int height, double noise )
+{
+    std::vector<unsigned char> image(width * height);
+    const int cell = 64;
+    srand(12345);
+    for ( int y = 0; y < height; y++ )
+    {
+        for ( int x = 0; x < width; x++ )
+        {
+            const int dx = x % cell - cell / 2;
+            const int dy = y % cell - cell / 2;
+            unsigned char v = dx * dx + dy * dy < cell * cell / 8 ? 1 : 0;
+            if ( rand() < noise * RAND_MAX ) v = 1 - v;
+            image[y * width + x] = v;
+        }
+    }
+    return image;
+}
+
+// Add the nodes of a width x height grid to the empty graph g, with t-links
+// 'data' towards the label of each pixel of image and n-links 'smoothness'
+// between 4-connected pixels; with connectivity 8 the diagonal pixels are
+// joined too, by n-links 'diagonal'.
+template <typename GraphType, typename tcaptype, typename captype>
+void add_denoising_grid( GraphType *g, const std::vector<unsigned char> &image, int width, int height,
+                         tcaptype data, captype smoothness, int connectivity = 4, captype diagonal = 0 )
+{
+    g->add_node(width * height);
+    for ( int y = 0; y < height; y++ )
+    {
+        for ( int x = 0; x < width; x++ )
+        {
+            const int n = y * width + x;
+            g->add_tweights( n, image[n] ? data : 0, image[n] ? 0 : data );
+            if ( x + 1 < width ) g->add_edge( n, n + 1, smoothness, smoothness );
+            if ( y + 1 < height ) g->add_edge( n, n + width, smoothness, smoothness );
+            if ( connectivity == 8 && y + 1 < height )
+            {
+                if ( x + 1 < width ) g->add_edge( n, n + width + 1, diagonal, diagonal );
+                if ( x > 0 ) g->add_edge( n, n + width - 1, diagonal, diagonal );
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,352 @@
+// Maximum flow problems in the DIMACS format, the format of the instances of
+// the DIMACS challenges and of the vision instances of the University of
+// Western Ontario:
+//     c <comment>
+//     p max <number of nodes> <number of arcs>
+//     n <id> s                        the source
+//     n <id> t                        the sink
+//     a <from> <to> <capacity>        one arc, ids from 1 to the number of nodes
+//
+// read_dimacs() builds a Graph in one pass over the file, sized from the
+// 'p' line: the source and the sink become the terminals of the Graph, so
+// that their arcs are t-links (add_tweights()), and the other nodes keep the
+// order of their ids. write_dimacs() writes a Graph back (its residual graph
+// if it was solved), and dimacs_cut_value() reads a file again to give the
+// capacity of the cut found by maxflow(), which proves the flow maximal if
+// they are equal.
+
+#ifndef DIMACS_H
+#define DIMACS_H
+
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "maxflow-v3.03.src/graph.h"
+
+// Lines of a file read a large block at a time.
+class dimacs_line_reader
+{
+public:
+    explicit dimacs_line_reader( FILE *file ) : file(file), buffer(1 << 20), begin(0), end(0), line_number(0) {}
+
+    // Next line, with its end of line replaced by '\0'; NULL at the end of the file.
+    char *next()
+    {
+        for ( ;; )
+        {
+            char *line = &buffer[begin];
+            char *eol = (char *)memchr(line, '\n', end - begin);
+            if ( eol )
+            {
+                *eol = '\0';
+                begin = eol + 1 - &buffer[0];
+                line_number++;
+                return line;
+            }
+            // keep the start of the line and read after it
+            memmove(&buffer[0], line, end - begin);
+            end -= begin;
+            begin = 0;
+            if ( end + 1 >= buffer.size() ) buffer.resize(2 * buffer.size());
+            const size_t read = fread(&buffer[end], 1, buffer.size() - 1 - end, file);
+            if ( read == 0 )
+            {
+                if ( end == 0 ) return 0;
+                buffer[end] = '\0'; // last line without an end of line
+                begin = end;
+                line_number++;
+                return &buffer[0];
+            }
+            end += read;
+        }
+    }
+
+    long long get_line_number() const { return line_number; }
+
+private:
+    FILE *file;
+    std::vector<char> buffer;
+    size_t begin, end; // the unread characters are buffer[begin .. end - 1]
+    long long line_number;
+};
+
+// Reads a number of a DIMACS line at *p and moves p after it. Integers are
+// read digit by digit, other numbers by strtod().
+template <typename cap_t>
+bool dimacs_read_number( char *&p, cap_t &value )
+{
+    while ( *p == ' ' || *p == '\t' ) p++;
+    char *start = p;
+    bool negative = *p == '-';
+    if ( negative || *p == '+' ) p++;
+    if ( *p < '0' || *p > '9' ) return false;
+    long long v = 0;
+    while ( *p >= '0' && *p <= '9' ) v = 10 * v + (*p++ - '0');
+    if ( *p == '.' || *p == 'e' || *p == 'E' )
+    {
+        value = (cap_t)strtod(start, &p);
+        return true;
+    }
+    value = (cap_t)(negative ? -v : v);
+    return true;
+}
+
+// Reads a DIMACS maximum flow file, calling
+//     handler.problem(n, m)                  for the 'p' line
+//     handler.terminal(id, is_source)        for an 'n' line
+//     handler.arc(from, to, capacity)        for an 'a' line
+// Returns false if the file cannot be opened, if a line is malformed or if
+// a handler function returns false (read_dimacs() rejects a negative
+// capacity and more than INT_MAX arcs); *error_line is then the number of
+// the line (0 if the file could not be opened).
+template <typename cap_t, typename Handler>
+bool parse_dimacs( const char *file_name, Handler &handler, long long *error_line = 0 )
+{
+    if ( error_line ) *error_line = 0;
+    FILE *file = fopen(file_name, "rb");
+    if ( !file ) return false;
+
+    dimacs_line_reader reader(file);
+    bool ok = true;
+    char *line;
+    while ( ok && (line = reader.next()) )
+    {
+        char *p = line + 1;
+        switch ( line[0] )
+        {
+        case 'a':
+        {
+            int from, to;
+            cap_t capacity;
+            ok = dimacs_read_number(p, from) && dimacs_read_number(p, to) && dimacs_read_number(p, capacity)
+                 && handler.arc(from, to, capacity);
+            break;
+        }
+        case 'n':
+        {
+            int id;
+            ok = dimacs_read_number(p, id);
+            while ( *p == ' ' || *p == '\t' ) p++;
+            ok = ok && (*p == 's' || *p == 't') && handler.terminal(id, *p == 's');
+            break;
+        }
+        case 'p':
+        {
+            int n;
+            long long m;
+            while ( *p == ' ' || *p == '\t' ) p++;
+            ok = strncmp(p, "max", 3) == 0;
+            p += 3;
+            ok = ok && dimacs_read_number(p, n) && dimacs_read_number(p, m) && handler.problem(n, m);
+            break;
+        }
+        case 'c': case '\0': case '\r':
+            break;
+        default:
+            ok = false;
+        }
+    }
+    if ( !ok && error_line ) *error_line = reader.get_line_number();
+    fclose(file);
+    return ok;
+}
+
+// A DIMACS problem read into a Graph.
+template <typename GraphType>
+struct dimacs_graph
+{
+    dimacs_graph() : g(0), source(0), sink(0), node_num(0), arc_num(0) {}
+
+    GraphType *g;
+    int source, sink;                   // ids of the terminals
+    int node_num;                       // number of nodes of the file, terminals included
+    long long arc_num;                  // number of arcs of the file
+    std::vector<int> node_of_id;        // node of g of every id (-1 for the terminals)
+};
+
+// Handler of parse_dimacs() building the graph of read_dimacs().
+template <typename cap_t, typename GraphType>
+struct dimacs_graph_builder
+{
+    explicit dimacs_graph_builder( dimacs_graph<GraphType> &d ) : d(d) {}
+
+    bool problem( int n, long long m )
+    {
+        if ( d.g || n < 3 || m < 0 || m > INT_MAX ) return false;
+        d.node_num = n;
+        d.arc_num = m;
+        d.g = new GraphType(n - 2, (int)m);
+        return true;
+    }
+
+    bool terminal( int id, bool is_source )
+    {
+        if ( !d.g || id < 1 || id > d.node_num || !d.node_of_id.empty() ) return false;
+        (is_source ? d.source : d.sink) = id;
+        return true;
+    }
+
+    bool arc( int from, int to, cap_t capacity )
+    {
+        if ( d.node_of_id.empty() && !number_nodes() ) return false;
+        if ( from < 1 || from > d.node_num || to < 1 || to > d.node_num || capacity < 0 ) return false;
+        const int i = d.node_of_id[from];
+        const int j = d.node_of_id[to];
+        if ( from == d.source && to == d.sink )
+        {
+            // no node on the way: the flow of any cut, added to node 0 on both sides
+            d.g->add_tweights( 0, capacity, capacity );
+        }
+        else if ( from == d.source )
+        {
+            if ( j >= 0 ) d.g->add_tweights( j, capacity, 0 );
+        }
+        else if ( to == d.sink )
+        {
+            if ( i >= 0 ) d.g->add_tweights( i, 0, capacity );
+        }
+        else if ( i >= 0 && j >= 0 && i != j )
+        {
+            // arcs into the source and out of the sink carry no flow
+            d.g->add_edge( i, j, capacity, 0 );
+        }
+        return true;
+    }
+
+    // The nodes of the graph, once the terminals are known (before the first arc).
+    bool number_nodes()
+    {
+        if ( !d.g || !d.source || !d.sink || d.source == d.sink ) return false;
+        d.node_of_id.assign(d.node_num + 1, -1);
+        int k = 0;
+        for ( int id = 1; id <= d.node_num; id++ )
+        {
+            if ( id != d.source && id != d.sink ) d.node_of_id[id] = k++;
+        }
+        d.g->add_node(k);
+        return true;
+    }
+
+    dimacs_graph<GraphType> &d;
+};
+
+// Reads DIMACS file 'file_name' into d.g, a new GraphType whose capacities
+// are read as cap_t. On failure, returns false and deletes the graph; see
+// parse_dimacs() about error_line.
+template <typename cap_t, typename GraphType>
+bool read_dimacs( const char *file_name, dimacs_graph<GraphType> &d, long long *error_line = 0 )
+{
+    d = dimacs_graph<GraphType>();
+    dimacs_graph_builder<cap_t, GraphType> builder(d);
+    bool ok = parse_dimacs<cap_t>(file_name, builder, error_line);
+    if ( ok && d.node_of_id.empty() ) ok = builder.number_nodes(); // no arc
+    if ( !ok )
+    {
+        delete d.g;
+        d = dimacs_graph<GraphType>();
+    }
+    return ok;
+}
+
+// Handler of parse_dimacs() adding the capacities of the arcs that go from
+// the source side of the cut of a solved graph to its sink side.
+template <typename cap_t, typename GraphType>
+struct dimacs_cut_adder
+{
+    explicit dimacs_cut_adder( dimacs_graph<GraphType> &d ) : d(d), value(0) {}
+
+    bool problem( int, long long ) { return true; }
+    bool terminal( int, bool ) { return true; }
+    bool arc( int from, int to, cap_t capacity )
+    {
+        if ( from < 1 || from > d.node_num || to < 1 || to > d.node_num ) return false;
+        if ( on_source_side(from) && !on_source_side(to) ) value += capacity;
+        return true;
+    }
+
+    bool on_source_side( int id )
+    {
+        if ( id == d.source ) return true;
+        if ( id == d.sink ) return false;
+        return d.g->what_segment(d.node_of_id[id]) == GraphType::SOURCE;
+    }
+
+    dimacs_graph<GraphType> &d;
+    double value;
+};
+
+// Capacity of the cut of d.g (after maxflow()) in the arcs of the file it
+// was read from, or -1 if the file cannot be read.
+template <typename cap_t, typename GraphType>
+double dimacs_cut_value( const char *file_name, dimacs_graph<GraphType> &d )
+{
+    dimacs_cut_adder<cap_t, GraphType> adder(d);
+    return parse_dimacs<cap_t>(file_name, adder) ? adder.value : -1;
+}
+
+template <typename cap_t>
+void dimacs_write_number( FILE *file, cap_t value )
+{
+    if ( (cap_t)0.5 == 0 ) fprintf(file, " %lld", (long long)value);
+    else                   fprintf(file, " %.17g", (double)value);
+}
+
+// Writes graph g to DIMACS file 'file_name': node i of g is id i + 1, the
+// source and the sink are the last two ids, and every arc and t-link of
+// positive residual capacity is an arc. The flow g already carries (see
+// Graph::get_flow()) is an arc from the source to the sink, so that the
+// maximum flow of the file is the one of g. Returns false if the file
+// cannot be written.
+template <typename cap_t, typename GraphType>
+bool write_dimacs( GraphType *g, const char *file_name )
+{
+    const int n = g->get_node_num();
+    const int source = n + 1;
+    const int sink = n + 2;
+
+    long long m = g->get_flow() > 0 ? 1 : 0;
+    for ( int i = 0; i < n; i++ )
+    {
+        if ( g->get_trcap(i) != 0 ) m++;
+    }
+    typename GraphType::arc_id a = g->get_first_arc();
+    for ( int k = 0; k < g->get_arc_num(); k++, a = g->get_next_arc(a) )
+    {
+        if ( g->get_rcap(a) > 0 ) m++;
+    }
+
+    FILE *file = fopen(file_name, "wb");
+    if ( !file ) return false;
+    fprintf(file, "p max %d %lld\nn %d s\nn %d t\n", n + 2, m, source, sink);
+    if ( g->get_flow() > 0 )
+    {
+        fprintf(file, "a %d %d", source, sink);
+        dimacs_write_number<cap_t>(file, (cap_t)g->get_flow());
+        fputc('\n', file);
+    }
+    for ( int i = 0; i < n; i++ )
+    {
+        const cap_t trcap = (cap_t)g->get_trcap(i);
+        if ( trcap == 0 ) continue;
+        if ( trcap > 0 ) fprintf(file, "a %d %d", source, i + 1);
+        else             fprintf(file, "a %d %d", i + 1, sink);
+        dimacs_write_number<cap_t>(file, trcap > 0 ? trcap : -trcap);
+        fputc('\n', file);
+    }
+    a = g->get_first_arc();
+    for ( int k = 0; k < g->get_arc_num(); k++, a = g->get_next_arc(a) )
+    {
+        const cap_t rcap = (cap_t)g->get_rcap(a);
+        if ( rcap <= 0 ) continue;
+        typename GraphType::node_id i, j;
+        g->get_arc_ends(a, i, j);
+        fprintf(file, "a %d %d", i + 1, j + 1);
+        dimacs_write_number<cap_t>(file, rcap);
+        fputc('\n', file);
+    }
+    return fclose(file) == 0;
+}
+
+#endif
@@ -0,0 +1,84 @@
+// Benchmark of Graph on maximum flow problems in the DIMACS format (see
+// dimacs.h), such as the vision instances of the University of Western
+// Ontario and the instances of the DIMACS challenges.
+//
+// Every file is read into a Graph with read_dimacs(), solved with the given
+// algorithm, and read again to add the capacities of the arcs across the
+// cut, which must be the flow. The time of each step is printed, with the
+// number of arcs read per second and the number of nodes solved per second.
+//
+// usage: dimacs_benchmark [bk|hpf|ibfs] file.max ...
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "dimacs.h"
+
+// Capacities are read as doubles, which hold the flows of integer capacities
+// of any instance exactly, where an int could overflow.
+typedef Graph<double, double, double, GRAPH_INDICES> GraphType;
+
+typedef std::chrono::steady_clock clock_type;
+
+double seconds_since( clock_type::time_point t )
+{
+    return std::chrono::duration<double>(clock_type::now() - t).count();
+}
+
+// Reads, solves and checks one file; returns false if it cannot be read or
+// if the cut is not the flow.
+bool run( const char *file_name, GraphType::algotype algorithm )
+{
+    dimacs_graph<GraphType> d;
+    long long error_line;
+    clock_type::time_point t = clock_type::now();
+    if ( !read_dimacs<double>(file_name, d, &error_line) )
+    {
+        if ( error_line ) printf("%s: line %lld is not valid\n", file_name, error_line);
+        else printf("%s: cannot be read\n", file_name);
+        return false;
+    }
+    const double parse_time = seconds_since(t);
+
+    d.g->set_algorithm(algorithm);
+    t = clock_type::now();
+    const double flow = d.g->maxflow();
+    const double solve_time = seconds_since(t);
+
+    t = clock_type::now();
+    const double cut = dimacs_cut_value<double>(file_name, d);
+    const double verify_time = seconds_since(t);
+
+    const bool ok = cut == flow;
+    printf("%s: %d nodes, %lld arcs, parse %.3f s (%.1f M arcs/s), solve %.3f s (%.1f M nodes/s), "
+           "verify %.3f s, flow %.17g, %s\n",
+           file_name, d.node_num, d.arc_num, parse_time, d.arc_num / parse_time / 1e6,
+           solve_time, d.node_num / solve_time / 1e6, verify_time, flow,
+           ok ? "cut = flow" : "CUT DIFFERS FROM THE FLOW");
+    fflush(stdout);
+    delete d.g;
+    return ok;
+}
+
+int main( int argc, char **argv )
+{
+    GraphType::algotype algorithm = GraphType::BK;
+    int first = 1;
+    if ( argc >= 2 && !strcmp(argv[1], "bk") )   { algorithm = GraphType::BK; first = 2; }
+    if ( argc >= 2 && !strcmp(argv[1], "hpf") )  { algorithm = GraphType::HPF; first = 2; }
+    if ( argc >= 2 && !strcmp(argv[1], "ibfs") ) { algorithm = GraphType::IBFS; first = 2; }
+    if ( first >= argc )
+    {
+        fprintf(stderr, "usage: %s [bk|hpf|ibfs] file.max ...\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+    for ( int k = first; k < argc; k++ )
+    {
+        if ( !run(argv[k], algorithm) ) failed++;
+    }
+    if ( failed ) printf("%d of %d instances failed\n", failed, argc - first);
+    return failed ? 1 : 0;
+}
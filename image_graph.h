@@ -0,0 +1,379 @@
+// Construction of the graph of formula (12.12) in Computer Vision: Models,
+// Learning, and Inference directly from an image, in time linear in the
+// number of pixels.
+//
+// Pixel (r, c) is node r * cols + c (zero-based index, row-major order).
+// Every pixel gets its t-links and one n-link to its right and one to its
+// lower neighbour, so each 4-connected pair is visited exactly once and
+// no neighbourhood search is needed.
+
+#ifndef IMAGE_GRAPH_H
+#define IMAGE_GRAPH_H
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "maxflow-v3.03.src/gridgraph.h"
+
+// Number of n-links of a rows x cols 4-connected grid.
+inline int grid_edge_count(int rows, int cols)
+{
+    return rows * (cols - 1) + (rows - 1) * cols;
+}
+
+// Allocation of an empty graph for a rows x cols grid. A Graph gets room
+// for exactly the nodes and n-links of the grid, so that no reallocation
+// happens while the grid is added; a GridGraph is the grid itself.
+template <typename GraphType>
+struct grid_graph_allocator
+{
+    static GraphType *allocate(int rows, int cols)
+    {
+        return new GraphType(rows * cols, grid_edge_count(rows, cols));
+    }
+};
+
+template <typename captype, typename tcaptype, typename flowtype>
+struct grid_graph_allocator< GridGraph<captype, tcaptype, flowtype> >
+{
+    static GridGraph<captype, tcaptype, flowtype> *allocate(int rows, int cols)
+    {
+        return new GridGraph<captype, tcaptype, flowtype>(cols, rows);
+    }
+};
+
+template <typename GraphType>
+GraphType *new_grid_graph(int rows, int cols)
+{
+    return grid_graph_allocator<GraphType>::allocate(rows, cols);
+}
+
+// Order of the pixels of a rows x cols grid along a Morton (Z-order) curve,
+// for Graph::reorder_nodes(): pixels close in the image are then close in
+// memory in both directions, not only along the rows. The grid is cut in
+// square blocks of a power of two side, taken row by row, and each block
+// is walked along the curve.
+inline void grid_morton_order(int rows, int cols, std::vector<int> &order)
+{
+    int side = 1;
+    while ( 2 * side <= std::min(rows, cols) ) side *= 2;
+
+    order.clear();
+    order.reserve(rows * cols);
+    for ( int r0 = 0; r0 < rows; r0 += side )
+    {
+        for ( int c0 = 0; c0 < cols; c0 += side )
+        {
+            for ( int code = 0; code < side * side; code++ )
+            {
+                // the even bits of code are the column, the odd bits the row
+                int r = 0, c = 0;
+                for ( int b = 0; (1 << b) < side; b++ )
+                {
+                    c |= ((code >> (2 * b)) & 1) << b;
+                    r |= ((code >> (2 * b + 1)) & 1) << b;
+                }
+                if ( r0 + r < rows && c0 + c < cols )
+                {
+                    order.push_back((r0 + r) * cols + c0 + c);
+                }
+            }
+        }
+    }
+}
+
+// Add the nodes, t-links and n-links of an image energy to an empty graph.
+//
+// 'energy' must provide
+//     source(w)        capacity of the edge SOURCE->n for a pixel of value w
+//     sink(w)          capacity of the edge n->SINK for a pixel of value w
+//     pairwise(w, v)   capacity of the edge m->n between the 4-connected
+//                      pixels m and n of values w and v
+// where pixel_t is the element type of 'image'.
+template <typename pixel_t, typename GraphType, typename Energy>
+void build_grid_graph(GraphType *g, const cv::Mat &image, const Energy &energy)
+{
+    assert(image.type() == cv::DataType<pixel_t>::type);
+
+    const int rows = image.rows;
+    const int cols = image.cols;
+
+    typename GraphType::node_id n = g->add_node(rows * cols);
+
+    for ( int r = 0; r < rows; r++ )
+    {
+        const pixel_t *row = image.ptr<pixel_t>(r);
+        const pixel_t *below = r + 1 < rows ? image.ptr<pixel_t>(r + 1) : 0;
+
+        for ( int c = 0; c < cols; c++, n++ )
+        {
+            const pixel_t w_n = row[c];
+
+            g->add_tweights( n, energy.source(w_n), energy.sink(w_n) );
+
+            if ( c + 1 < cols )
+            {
+                const pixel_t w_m = row[c + 1];
+                g->add_edge( n, n + 1, energy.pairwise(w_n, w_m), energy.pairwise(w_m, w_n) );
+            }
+            if ( below )
+            {
+                const pixel_t w_m = below[c];
+                g->add_edge( n, n + cols, energy.pairwise(w_n, w_m), energy.pairwise(w_m, w_n) );
+            }
+        }
+    }
+}
+
+// Replace the capacities of a Graph built by build_grid_graph() for an image
+// of the same size by those of 'image', keeping its nodes and arcs: one pass
+// of capacity writes, in the order of build_grid_graph(). The arcs must still
+// be in that order: not after Graph::finalize() or Graph::reorder_nodes()
+// (see Graph::arcs_in_add_order()), which would put the capacities on other
+// edges.
+template <typename pixel_t, typename GraphType, typename Energy>
+void refill_grid_graph(GraphType *g, const cv::Mat &image, const Energy &energy)
+{
+    assert(image.type() == cv::DataType<pixel_t>::type);
+
+    const int rows = image.rows;
+    const int cols = image.cols;
+    assert(g->get_node_num() == rows * cols);
+    assert(g->get_arc_num() == 2 * grid_edge_count(rows, cols));
+    assert(g->arcs_in_add_order());
+
+    g->reset_capacities();
+
+    typename GraphType::node_id n = 0;
+    typename GraphType::arc_id a = g->get_first_arc();
+
+    for ( int r = 0; r < rows; r++ )
+    {
+        const pixel_t *row = image.ptr<pixel_t>(r);
+        const pixel_t *below = r + 1 < rows ? image.ptr<pixel_t>(r + 1) : 0;
+
+        for ( int c = 0; c < cols; c++, n++ )
+        {
+            const pixel_t w_n = row[c];
+
+            g->add_tweights( n, energy.source(w_n), energy.sink(w_n) );
+
+            if ( c + 1 < cols )
+            {
+                const pixel_t w_m = row[c + 1];
+                g->set_edge( a, energy.pairwise(w_n, w_m), energy.pairwise(w_m, w_n) );
+                a = g->get_next_arc(g->get_next_arc(a));
+            }
+            if ( below )
+            {
+                const pixel_t w_m = below[c];
+                g->set_edge( a, energy.pairwise(w_n, w_m), energy.pairwise(w_m, w_n) );
+                a = g->get_next_arc(g->get_next_arc(a));
+            }
+        }
+    }
+}
+
+// Add the nodes, t-links and n-links of an energy given as cost images to
+// an empty graph. All images have the size of the grid and element type
+// cost_t:
+//     source_cost(r, c)   capacity of the edge SOURCE->(r, c)
+//     sink_cost(r, c)     capacity of the edge (r, c)->SINK
+//     right_cost(r, c)    capacity (in both directions) of the n-link
+//                         between (r, c) and (r, c + 1); the last column
+//                         is ignored
+//     down_cost(r, c)     capacity (in both directions) of the n-link
+//                         between (r, c) and (r + 1, c); the last row is
+//                         ignored
+template <typename cost_t, typename GraphType>
+void build_grid_graph(GraphType *g,
+                      const cv::Mat &source_cost, const cv::Mat &sink_cost,
+                      const cv::Mat &right_cost, const cv::Mat &down_cost)
+{
+    assert(source_cost.type() == cv::DataType<cost_t>::type);
+    assert(sink_cost.type() == cv::DataType<cost_t>::type);
+    assert(right_cost.type() == cv::DataType<cost_t>::type);
+    assert(down_cost.type() == cv::DataType<cost_t>::type);
+
+    const int rows = source_cost.rows;
+    const int cols = source_cost.cols;
+
+    typename GraphType::node_id n = g->add_node(rows * cols);
+
+    for ( int r = 0; r < rows; r++ )
+    {
+        const cost_t *source = source_cost.ptr<cost_t>(r);
+        const cost_t *sink = sink_cost.ptr<cost_t>(r);
+        const cost_t *right = right_cost.ptr<cost_t>(r);
+        const cost_t *down = down_cost.ptr<cost_t>(r);
+        const bool has_below = r + 1 < rows;
+
+        for ( int c = 0; c < cols; c++, n++ )
+        {
+            g->add_tweights( n, source[c], sink[c] );
+
+            if ( c + 1 < cols )
+            {
+                g->add_edge( n, n + 1, right[c], right[c] );
+            }
+            if ( has_below )
+            {
+                g->add_edge( n, n + cols, down[c], down[c] );
+            }
+        }
+    }
+}
+
+// Segmentation of a Graph built for a rows x cols grid, written into 'out'
+// (allocated as CV_8UC1 if needed): source_value for the pixels in the SOURCE
+// segment, sink_value for those in the SINK segment. The rows are cut in
+// thread_num bands exported in parallel with Graph::export_segmentation().
+template <typename GraphType>
+void export_grid_segmentation(GraphType *g, int rows, int cols, cv::Mat &out,
+                              unsigned char source_value, unsigned char sink_value,
+                              int thread_num = 1)
+{
+    assert(g->get_node_num() == rows * cols);
+    out.create(rows, cols, CV_8UC1);
+
+    auto export_rows = [&](int first_row, int last_row)
+    {
+        if ( out.isContinuous() )
+        {
+            g->export_segmentation(out.ptr<unsigned char>(first_row), source_value, sink_value,
+                                   GraphType::SOURCE, first_row * cols, (last_row - first_row) * cols);
+            return;
+        }
+        for ( int r = first_row; r < last_row; r++ )
+        {
+            g->export_segmentation(out.ptr<unsigned char>(r), source_value, sink_value,
+                                   GraphType::SOURCE, r * cols, cols);
+        }
+    };
+
+    thread_num = std::max(1, std::min(thread_num, rows));
+    if ( thread_num == 1 )
+    {
+        export_rows(0, rows);
+        return;
+    }
+    std::vector<std::thread> threads;
+    for ( int t = 0; t < thread_num; t++ )
+    {
+        threads.push_back(std::thread(export_rows, rows * t / thread_num, rows * (t + 1) / thread_num));
+    }
+    for ( size_t t = 0; t < threads.size(); t++ )
+    {
+        threads[t].join();
+    }
+}
+
+// Capacity types of the graph of solve_compact_grid_graph(), from the
+// narrowest: Graph<unsigned char, short, int>, Graph<short, int, int>,
+// Graph<int, int, int> and Graph<double, double, double>.
+enum grid_capacity_type { GRID_CAPACITY_UINT8, GRID_CAPACITY_INT16, GRID_CAPACITY_INT32, GRID_CAPACITY_DOUBLE };
+
+// Narrowest capacity type in which the graph of 'image' (CV_8UC1) and
+// 'energy' (as for build_grid_graph()) is solved without overflow:
+//     captype     holds pairwise(w_m, w_n) + pairwise(w_n, w_m), the residual
+//                 capacities of the two arcs of an n-link adding up to it
+//     tcaptype    holds source(w) and sink(w), and so their difference tr_cap,
+//                 plus the capacities of the 4 n-links of a pixel, which
+//                 Graph::fix_persistent_nodes() may move to its t-links
+//     flowtype    holds the number of pixels times the largest source(w),
+//                 which the flow cannot exceed
+// for the values w, w_m and w_n found in the image. The integer types need
+// integer capacities that are not negative; any other energy gets double.
+// (The same types hold for HPF and IBFS: HPF gathers excesses in flowtype
+// and sends back what a t-link cannot hold. The captype of GRID_CAPACITY_UINT8
+// is unsigned: Graph::edit_edge() computes the residual capacities, which may
+// go below 0, in tcaptype, but the new capacities of an edit must still fit in
+// captype, both directions of an n-link adding up to 255 at most.)
+template <typename Energy>
+grid_capacity_type select_grid_capacity_type(const cv::Mat &image, const Energy &energy)
+{
+    assert(image.type() == CV_8UC1);
+
+    bool found[256] = { false };
+    for ( int r = 0; r < image.rows; r++ )
+    {
+        const unsigned char *row = image.ptr<unsigned char>(r);
+        for ( int c = 0; c < image.cols; c++ )
+        {
+            found[row[c]] = true;
+        }
+    }
+
+    // an integer capacity that is not negative, or -1
+    auto integer = [](double cap) { return cap >= 0 && cap == std::floor(cap) ? cap : -1.0; };
+
+    double max_tcap = 0, max_cap = 0;
+    for ( int w_m = 0; w_m < 256; w_m++ )
+    {
+        if ( !found[w_m] ) continue;
+        const double source = integer(energy.source((unsigned char)w_m));
+        const double sink = integer(energy.sink((unsigned char)w_m));
+        if ( source < 0 || sink < 0 ) return GRID_CAPACITY_DOUBLE;
+        max_tcap = std::max(max_tcap, std::max(source, sink));
+
+        for ( int w_n = w_m; w_n < 256; w_n++ )
+        {
+            if ( !found[w_n] ) continue;
+            const double cap = integer(energy.pairwise((unsigned char)w_m, (unsigned char)w_n));
+            const double rev_cap = integer(energy.pairwise((unsigned char)w_n, (unsigned char)w_m));
+            if ( cap < 0 || rev_cap < 0 ) return GRID_CAPACITY_DOUBLE;
+            max_cap = std::max(max_cap, cap + rev_cap);
+        }
+    }
+    const double max_flow = (double)image.rows * image.cols * max_tcap;
+
+    if ( max_flow > INT_MAX || max_tcap + 4 * max_cap > INT_MAX ) return GRID_CAPACITY_DOUBLE;
+    if ( max_cap > SHRT_MAX ) return GRID_CAPACITY_INT32;
+    if ( max_cap > UCHAR_MAX || max_tcap + 4 * max_cap > SHRT_MAX ) return GRID_CAPACITY_INT16;
+    return GRID_CAPACITY_UINT8;
+}
+
+// Build the graph of 'image' and 'energy' as a GraphType with the indices
+// layout and call solver(g) before deleting it.
+template <typename GraphType, typename Energy, typename Solver>
+void solve_grid_graph(const cv::Mat &image, const Energy &energy, Solver &solver)
+{
+    GraphType *g = new_grid_graph<GraphType>(image.rows, image.cols);
+    build_grid_graph<unsigned char>(g, image, energy);
+    solver(g);
+    delete g;
+}
+
+// Build the graph of 'image' (CV_8UC1) and 'energy' (as for
+// build_grid_graph()) with the narrowest capacity type of
+// select_grid_capacity_type() and the GRAPH_INDICES layout, and call
+// solver(g), a function template over the graph type (g is deleted after
+// it). Smaller residual capacities make smaller nodes and arcs, and fewer
+// bytes read by the growth and the augmentations of maxflow(). Returns the
+// capacity type.
+template <typename Energy, typename Solver>
+grid_capacity_type solve_compact_grid_graph(const cv::Mat &image, const Energy &energy, Solver &solver)
+{
+    const grid_capacity_type type = select_grid_capacity_type(image, energy);
+    switch ( type )
+    {
+    case GRID_CAPACITY_UINT8:
+        solve_grid_graph< Graph<unsigned char, short, int, GRAPH_INDICES> >(image, energy, solver);
+        break;
+    case GRID_CAPACITY_INT16:
+        solve_grid_graph< Graph<short, int, int, GRAPH_INDICES> >(image, energy, solver);
+        break;
+    case GRID_CAPACITY_INT32:
+        solve_grid_graph< Graph<int, int, int, GRAPH_INDICES> >(image, energy, solver);
+        break;
+    default:
+        solve_grid_graph< Graph<double, double, double, GRAPH_INDICES> >(image, energy, solver);
+    }
+    return type;
+}
+
+#endif
@@ -0,0 +1,154 @@
+// Benchmark of the memory layouts of Graph (see graph.h) on a large
+// 4-connected grid.
+//
+// The grid is a binary denoising problem of the kind solved by test.cpp: a
+// noisy image of disks, data terms from the noisy pixels and a constant
+// smoothness term. For every layout the graph is built and solved, and the
+// build time, the solve time, the bytes per node and (on Linux, when the
+// kernel allows it) the hardware cache misses of the solve are printed.
+//
+// usage: layout_benchmark [width height [smoothness]]
+//
+// The cache misses are read with perf_event_open(); if they are reported as
+// n/a, run the benchmark under 'perf stat -e cache-misses' instead.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+#include "maxflow-v3.03.src/graph.h"
+#include "benchmark_grids.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+// Counter of the hardware cache misses of this process.
+class cache_miss_counter
+{
+public:
+    cache_miss_counter() : fd(-1)
+    {
+#ifdef __linux__
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+    }
+
+    ~cache_miss_counter()
+    {
+#ifdef __linux__
+        if ( fd >= 0 ) close(fd);
+#endif
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start()
+    {
+#ifdef __linux__
+        if ( fd >= 0 )
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    long long stop()
+    {
+        long long count = 0;
+#ifdef __linux__
+        if ( fd >= 0 )
+        {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if ( read(fd, &count, sizeof(count)) != sizeof(count) ) count = 0;
+        }
+#endif
+        return count;
+    }
+
+private:
+    int fd;
+};
+
+double seconds( clock_t from, clock_t to )
+{
+    return double(to - from) / CLOCKS_PER_SEC;
+}
+
+template <int layout>
+void run( const char *name, const std::vector<unsigned char> &image, int width, int height, int smoothness )
+{
+    typedef Graph<int, int, int, layout> GraphType;
+    const int N = width * height;
+    const int data = 10;
+
+    clock_t t0 = clock();
+    GraphType *g = new GraphType(N, 2 * N);
+    add_denoising_grid(g, image, width, height, data, smoothness);
+    clock_t t1 = clock();
+
+    cache_miss_counter counter;
+    counter.start();
+    const int flow = g->maxflow();
+    const long long misses = counter.stop();
+    clock_t t2 = clock();
+
+    const double bytes = double(g->get_memory_size()) / N;
+
+    if ( counter.available() )
+    {
+        printf("%-22s flow %d  build %.2f s  solve %.2f s  %.1f bytes/node  %lld cache misses\n",
+               name, flow, seconds(t0, t1), seconds(t1, t2), bytes, misses);
+    }
+    else
+    {
+        printf("%-22s flow %d  build %.2f s  solve %.2f s  %.1f bytes/node  n/a cache misses\n",
+               name, flow, seconds(t0, t1), seconds(t1, t2), bytes);
+    }
+
+    delete g;
+}
+
+int main( int argc, char **argv )
+{
+    int width = 2000;
+    int height = 2000;
+    int smoothness = 8;
+    if ( argc >= 3 )
+    {
+        width = atoi(argv[1]);
+        height = atoi(argv[2]);
+    }
+    if ( argc >= 4 )
+    {
+        smoothness = atoi(argv[3]);
+    }
+    if ( width <= 0 || height <= 0 )
+    {
+        fprintf(stderr, "usage: %s [width height [smoothness]]\n", argv[0]);
+        return 1;
+    }
+
+    const std::vector<unsigned char> image = make_noisy_image(width, height, 0.2);
+
+    printf("%d x %d grid, smoothness %d\n", width, height, smoothness);
+    run<GRAPH_POINTERS>("GRAPH_POINTERS", image, width, height, smoothness);
+    run<GRAPH_INDICES>("GRAPH_INDICES", image, width, height, smoothness);
+    run<GRAPH_INDICES_SPLIT>("GRAPH_INDICES_SPLIT", image, width, height, smoothness);
+
+    return 0;
+}
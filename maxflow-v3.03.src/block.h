@@ -293,5 +293,99 @@ private:
 };
 
 
+/***********************************************************************/
+/***********************************************************************/
+/***********************************************************************/
+
+/*
+	Template class Deque
+	A queue of items of the same type stored in one contiguous ring,
+	to which items can be added at both ends and taken from the front.
+	The ring is doubled when it is full; its memory is kept until
+	the destructor is called, so that a deque reused many times
+	stops allocating once it is large enough.
+
+	Note that no constructors or destructors are called for items.
+*/
+
+template <class Type> class Deque
+{
+public:
+	/* Constructor. Arguments are the initial number of items
+	   (rounded up to a power of two) and (optionally) the pointer
+	   to the function which will be called if allocation failed;
+	   the message passed to this function is "Not enough memory!" */
+	Deque(int size, void (*err_function)(const char *) = NULL)
+	{
+		int s = 1;
+		while (s < size) s *= 2;
+		items = (Type *) malloc(s*sizeof(Type));
+		if (!items) { if (err_function) (*err_function)("Not enough memory!"); exit(1); }
+		mask = s - 1;
+		first = count = 0;
+		error_function = err_function;
+	}
+
+	/* Destructor */
+	~Deque() { free(items); }
+
+	bool IsEmpty() { return count == 0; }
+
+	/* Number of items the ring can hold before it is doubled */
+	int Capacity() { return mask + 1; }
+
+	/* Adds an item at the front */
+	void PushFront(Type t)
+	{
+		if (count > mask) Grow();
+		first = (first - 1) & mask;
+		items[first] = t;
+		count ++;
+	}
+
+	/* Adds an item at the rear */
+	void PushBack(Type t)
+	{
+		if (count > mask) Grow();
+		items[(first + count) & mask] = t;
+		count ++;
+	}
+
+	/* Removes the item at the front and returns it. The deque must not be empty */
+	Type PopFront()
+	{
+		Type t = items[first];
+		first = (first + 1) & mask;
+		count --;
+		return t;
+	}
+
+	/* Removes all items (the memory is kept) */
+	void Reset() { first = count = 0; }
+
+/***********************************************************************/
+
+private:
+
+	Type		*items;
+	int			mask;		// size of the ring minus one
+	int			first;		// position of the front item
+	int			count;		// number of items
+
+	void	(*error_function)(const char *);
+
+	void Grow()
+	{
+		int size = mask + 1;
+		Type *p = (Type *) realloc(items, 2*size*sizeof(Type));
+		if (!p) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+		items = p;
+		/* the ring is full: the items wrapped around its end go after the old end */
+		for (int k=0; k<first; k++) items[size + k] = items[k];
+		mask = 2*size - 1;
+	}
+};
+
+
 #endif
 
@@ -9,62 +9,588 @@
 /*
 	special constants for node->parent. Duplicated in maxflow.cpp, both should match!
 */
-#define TERMINAL ( (arc *) 1 )		/* to terminal */
-#define ORPHAN   ( (arc *) 2 )		/* orphan */
+#define TERMINAL ( (arc_ref) 1 )		/* to terminal */
+#define ORPHAN   ( (arc_ref) 2 )		/* orphan */
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	Graph<captype, tcaptype, flowtype>::Graph(int node_num_max, int edge_num_max, void (*err_function)(const char *))
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	Graph<captype, tcaptype, flowtype, layout, schedule>::Graph(int node_num_max, int edge_num_max, void (*err_function)(const char *))
 	: node_num(0),
-	  nodeptr_block(NULL),
+	  orphan_queue(NULL),
 	  error_function(err_function)
 {
 	if (node_num_max < 16) node_num_max = 16;
 	if (edge_num_max < 16) edge_num_max = 16;
 
 	nodes = (node*) malloc(node_num_max*sizeof(node));
+	trees = (links::split_trees) ? (tree*) malloc(node_num_max*sizeof(tree)) : NULL;
 	arcs = (arc*) malloc(2*edge_num_max*sizeof(arc));
-	if (!nodes || !arcs) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	if (!nodes || !arcs || (links::split_trees && !trees)) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
 
 	node_last = nodes;
 	node_max = nodes + node_num_max;
 	arc_last = arcs;
 	arc_max = arcs + 2*edge_num_max;
 
+	tcaps = NULL;
+	caps = NULL;
+	node_pos = node_order = NULL;
+	arcs_reordered = false;
+	bucket_first = bucket_last = NULL;
+	bucket_num = 0;
+	checkpoint_file = NULL;
+	checkpoint_interval = 0;
+	is_part = false;
+	part_first = 0;
+
 	maxflow_iteration = 0;
+	algorithm = BK;
 	flow = 0;
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	Graph<captype,tcaptype,flowtype>::~Graph()
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	Graph<captype, tcaptype, flowtype, layout, schedule>::Graph(Graph* g, node_id first, node_id last)
+	: node_num(g->node_num),
+	  orphan_queue(NULL),
+	  error_function(g->error_function)
 {
-	if (nodeptr_block) 
-	{ 
-		delete nodeptr_block; 
-		nodeptr_block = NULL; 
+	nodes = g->nodes;
+	trees = g->trees;
+	arcs = g->arcs;
+	node_last = nodes + last;
+	node_max = g->node_max;
+	arc_last = g->arc_last;
+	arc_max = g->arc_max;
+
+	tcaps = NULL;
+	caps = NULL;
+	node_pos = node_order = NULL;
+	arcs_reordered = g->arcs_reordered;
+	bucket_first = bucket_last = NULL;
+	bucket_num = 0;
+	checkpoint_file = NULL;
+	checkpoint_interval = 0;
+	is_part = true;
+	part_first = first;
+
+	maxflow_iteration = 0;
+	algorithm = BK;
+	flow = 0;
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	Graph<captype,tcaptype,flowtype,layout,schedule>::~Graph()
+{
+	delete orphan_queue;
+	if (!is_part)
+	{
+		free(nodes);
+		free(trees);
+		free(arcs);
 	}
-	free(nodes);
-	free(arcs);
+	free(tcaps);
+	free(caps);
+	free(node_pos);
+	free(node_order);
+	free(bucket_first);
+	free(bucket_last);
+	free(checkpoint_file);
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::reset()
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::reset()
 {
 	node_last = nodes;
 	arc_last = arcs;
 	node_num = 0;
 
-	if (nodeptr_block) 
-	{ 
-		delete nodeptr_block; 
-		nodeptr_block = NULL; 
-	}
+	free(node_pos);
+	free(node_order);
+	node_pos = node_order = NULL;
+	arcs_reordered = false;
 
 	maxflow_iteration = 0;
 	flow = 0;
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::reallocate_nodes(int num)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::reset_capacities()
+{
+	node* i;
+	arc* a;
+
+	for (i=nodes; i<node_last; i++) { i->tr_cap = 0; i->is_fixed = 0; }
+	for (a=arcs; a<arc_last; a++) a->r_cap = 0;
+	if (tcaps) memset(tcaps, 0, 2*node_num*sizeof(tcaptype));
+	if (caps) memset(caps, 0, (arc_last - arcs)*sizeof(captype));
+
+	maxflow_iteration = 0;
+	flow = 0;
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::finalize()
+{
+	int arc_num = (int)(arc_last - arcs);
+	int arc_num_max = (int)(arc_max - arcs);
+	arc* arcs_old = arcs;
+	arc* arcs_new;
+	int *position, *start;
+	node* i;
+	int k, n, pos;
+
+	if (arc_num == 0) return;
+
+	/*
+		position[k] is the new index of arcs_old[k]: the arcs out of nodes[0] first,
+		then those out of nodes[1] and so on, each group in the order of arcs_old
+		(a counting sort by origin, which reads arcs_old sequentially)
+	*/
+	position = (int*) malloc(arc_num*sizeof(int));
+	start = (int*) calloc(node_num + 1, sizeof(int));
+	arcs_new = (arc*) malloc(arc_num_max*sizeof(arc));
+	if (!position || !start || !arcs_new) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	for (k=0; k<arc_num; k++) start[origin(arcs_old + k) + 1] ++;
+	for (n=0; n<node_num; n++) start[n + 1] += start[n];
+	for (k=0; k<arc_num; k++) position[k] = start[origin(arcs_old + k)] ++;
+
+	for (k=0; k<arc_num; k++)
+	{
+		arc* from = arcs_old + k;
+		arc* to = arcs_new + position[k];
+		to->head = from->head;
+		to->r_cap = from->r_cap;
+		to->sister = links::arc_ref_of(arcs_new, arcs_new + position[links::arc_ptr(arcs_old, from->sister) - arcs_old]);
+		to->next = (position[k] + 1 < start[origin(from)]) ? links::arc_ref_of(arcs_new, arcs_new + position[k] + 1) : 0;
+	}
+	/* start[n] is now the end of the arcs out of nodes[n] */
+	for (i=nodes, n=0; i<node_last; i++, n++)
+	{
+		pos = (n == 0) ? 0 : start[n - 1];
+		i->first = (pos < start[n]) ? links::arc_ref_of(arcs_new, arcs_new + pos) : 0;
+		if (maxflow_iteration == 0) continue; /* no search trees yet */
+		arc_ref& parent = T(NREF(i)).parent;
+		if (parent && parent != ORPHAN && parent != TERMINAL)
+		{
+			parent = links::arc_ref_of(arcs_new, arcs_new + position[links::arc_ptr(arcs_old, parent) - arcs_old]);
+		}
+	}
+	if (caps)
+	{
+		captype* caps_new = (captype*) malloc(arc_num_max*sizeof(captype));
+		if (!caps_new) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+		for (k=0; k<arc_num; k++) caps_new[position[k]] = caps[k];
+		free(caps);
+		caps = caps_new;
+	}
+
+	free(arcs_old);
+	free(position);
+	free(start);
+	arcs = arcs_new;
+	arc_last = arcs + arc_num;
+	arc_max = arcs + arc_num_max;
+	arcs_reordered = true;
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::reorder_nodes(const node_id* order)
+{
+	int node_num_max = (int)(node_max - nodes);
+	node* nodes_old = nodes;
+	node* nodes_new;
+	node_id* position;
+	node_id k, p;
+	arc* a;
+
+	if (maxflow_iteration > 0) { if (error_function) (*error_function)("reorder_nodes() must be called before maxflow()!"); exit(1); }
+
+	/* position[p] is the new index of nodes_old[p] */
+	position = (node_id*) malloc(node_num*sizeof(node_id));
+	nodes_new = (node*) malloc(node_num_max*sizeof(node));
+	if (!position || !nodes_new) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	for (p=0; p<node_num; p++) position[p] = -1;
+	for (k=0; k<node_num; k++)
+	{
+		if (order[k] < 0 || order[k] >= node_num || position[node_index(order[k])] >= 0)
+		{
+			if (error_function) (*error_function)("reorder_nodes(): the order is not a permutation of the nodes!");
+			exit(1);
+		}
+		position[node_index(order[k])] = k;
+	}
+
+	for (p=0; p<node_num; p++) nodes_new[position[p]] = nodes_old[p];
+	for (a=arcs; a<arc_last; a++)
+	{
+		a->head = links::node_ref_of(nodes_new, nodes_new + position[links::node_ptr(nodes_old, a->head) - nodes_old]);
+	}
+	if (tcaps)
+	{
+		tcaptype* tcaps_new = (tcaptype*) malloc(2*node_num_max*sizeof(tcaptype));
+		if (!tcaps_new) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+		for (p=0; p<node_num; p++)
+		{
+			tcaps_new[2*position[p]]   = tcaps[2*p];
+			tcaps_new[2*position[p]+1] = tcaps[2*p+1];
+		}
+		free(tcaps);
+		tcaps = tcaps_new;
+	}
+	if (!node_pos)
+	{
+		node_pos = (node_id*) malloc(node_num_max*sizeof(node_id));
+		node_order = (node_id*) malloc(node_num_max*sizeof(node_id));
+		if (!node_pos || !node_order) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	}
+	for (k=0; k<node_num; k++)
+	{
+		node_order[k] = order[k];
+		node_pos[order[k]] = k;
+	}
+
+	free(nodes_old);
+	free(position);
+	nodes = nodes_new;
+	node_last = nodes + node_num;
+	node_max = nodes + node_num_max;
+
+	finalize();
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::reorder_nodes()
+{
+	node_id* order = (node_id*) malloc(node_num*sizeof(node_id));
+	char* visited = (char*) calloc(node_num, 1);
+	node_id first, last = 0, k;
+	arc_ref a;
+
+	if (!order || !visited) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+
+	/* breadth-first search from each node not reached yet; order[] is the queue */
+	for (first=0, k=0; k<node_num; k++)
+	{
+		if (visited[k]) continue;
+		visited[k] = 1;
+		order[last ++] = k;
+		for ( ; first<last; first++)
+		{
+			for (a=nodes[order[first]].first; a; a=A(a).next)
+			{
+				node_id j = (node_id)(&N(A(a).head) - nodes);
+				if (!visited[j])
+				{
+					visited[j] = 1;
+					order[last ++] = j;
+				}
+			}
+		}
+	}
+	for (k=0; k<node_num; k++) order[k] = node_name(order[k]);
+
+	reorder_nodes(order);
+	free(order);
+	free(visited);
+}
+
+/*
+	header of the files of Graph::save() and Graph::load(), followed by the arrays
+	nodes, arcs, tcaps and caps (if has_caps), node_pos and node_order (if has_node_pos),
+	then by the flow, then (if has_state, in the files of checkpoints) by a
+	graph_file_state, the links current_node, queue_first[0..1] and queue_last[0..1],
+	the array trees (for GRAPH_INDICES_SPLIT) and the arrays bucket_first and bucket_last
+*/
+struct graph_file_header
+{
+	char		magic[8];		/* "BKGRAPH" */
+	uint32_t	version;
+	uint32_t	byte_order;		/* GRAPH_FILE_BYTE_ORDER as written by the machine that saved the file */
+	int32_t		layout;
+	int32_t		sizes[5];		/* captype, tcaptype, flowtype, node, arc */
+	int32_t		integer_types;	/* bit k: the k-th of captype, tcaptype, flowtype is an integer type */
+	int32_t		node_num, arc_num;
+	int32_t		has_caps, has_node_pos, has_state;
+	int32_t		arcs_reordered;	/* the arcs are not in the order of add_edge() (see Graph::arcs_in_add_order()) */
+	uint64_t	nodes_base, arcs_base; /* addresses of nodes[] and arcs[] when saved (for GRAPH_POINTERS) */
+};
+
+struct graph_file_state
+{
+	int32_t		TIME, maxflow_iteration, alternate;
+	int32_t		bucket_num, bucket_min, bucket_max;
+};
+
+static const uint32_t GRAPH_FILE_VERSION = 3;
+static const uint32_t GRAPH_FILE_BYTE_ORDER = 0x01020304;
+
+/* layout and value types of a Graph, the fields of the header checked by load() with sizes[3..4] */
+template <typename captype, typename tcaptype, typename flowtype, int layout> 
+	static void graph_file_type(graph_file_header& h)
+{
+	h.layout = layout;
+	h.sizes[0] = (int32_t) sizeof(captype);
+	h.sizes[1] = (int32_t) sizeof(tcaptype);
+	h.sizes[2] = (int32_t) sizeof(flowtype);
+	h.integer_types = (((captype) 0.5 == 0) ? 1 : 0) | (((tcaptype) 0.5 == 0) ? 2 : 0) | (((flowtype) 0.5 == 0) ? 4 : 0);
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::save(const char* filename)
+{
+	write_graph_file(filename, false, 0);
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::load(const char* filename)
+{
+	read_graph_file(filename, false);
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::set_checkpoint(const char* filename, int seconds)
+{
+	free(checkpoint_file);
+	checkpoint_file = NULL;
+	if (!filename) return;
+	checkpoint_file = (char*) malloc(strlen(filename) + 1);
+	if (!checkpoint_file) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	strcpy(checkpoint_file, filename);
+	checkpoint_interval = seconds;
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::write_checkpoint(node_ref current_node)
+{
+	/* written next to the file, then renamed over it, so that a job stopped while writing leaves the previous checkpoint */
+	char* tmp = (char*) malloc(strlen(checkpoint_file) + 5);
+	if (!tmp) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	strcpy(tmp, checkpoint_file);
+	strcat(tmp, ".tmp");
+	write_graph_file(tmp, true, current_node);
+	if (rename(tmp, checkpoint_file) != 0)
+	{
+		remove(checkpoint_file); /* rename() does not replace a file on every system */
+		if (rename(tmp, checkpoint_file) != 0) { if (error_function) (*error_function)("Cannot write the checkpoint file!"); exit(1); }
+	}
+	free(tmp);
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::write_graph_file(const char* filename, bool with_state, node_ref current_node)
+{
+	graph_file_header h;
+	int arc_num = (int)(arc_last - arcs);
+	FILE* fp = fopen(filename, "wb");
+	if (!fp) { if (error_function) (*error_function)("Cannot open the graph file!"); exit(1); }
+
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, "BKGRAPH", 8);
+	h.version = GRAPH_FILE_VERSION;
+	h.byte_order = GRAPH_FILE_BYTE_ORDER;
+	graph_file_type<captype,tcaptype,flowtype,layout>(h);
+	h.sizes[3] = (int32_t) sizeof(node);
+	h.sizes[4] = (int32_t) sizeof(arc);
+	h.node_num = node_num;
+	h.arc_num = arc_num;
+	h.has_caps = (tcaps) ? 1 : 0;
+	h.has_node_pos = (node_pos) ? 1 : 0;
+	h.has_state = (with_state) ? 1 : 0;
+	h.arcs_reordered = (arcs_reordered) ? 1 : 0;
+	h.nodes_base = (uint64_t) (uintptr_t) nodes;
+	h.arcs_base = (uint64_t) (uintptr_t) arcs;
+
+	bool ok = fwrite(&h, sizeof(h), 1, fp) == 1
+	       && fwrite(nodes, sizeof(node), node_num, fp) == (size_t) node_num
+	       && fwrite(arcs, sizeof(arc), arc_num, fp) == (size_t) arc_num;
+	if (ok && tcaps)
+	{
+		ok = fwrite(tcaps, sizeof(tcaptype), 2*node_num, fp) == (size_t) 2*node_num
+		  && fwrite(caps, sizeof(captype), arc_num, fp) == (size_t) arc_num;
+	}
+	if (ok && node_pos)
+	{
+		ok = fwrite(node_pos, sizeof(node_id), node_num, fp) == (size_t) node_num
+		  && fwrite(node_order, sizeof(node_id), node_num, fp) == (size_t) node_num;
+	}
+	ok = ok && fwrite(&flow, sizeof(flowtype), 1, fp) == 1;
+	if (ok && with_state)
+	{
+		graph_file_state st = { TIME, maxflow_iteration, alternate, bucket_num, bucket_min, bucket_max };
+		node_ref refs[5] = { current_node, queue_first[0], queue_first[1], queue_last[0], queue_last[1] };
+		ok = fwrite(&st, sizeof(st), 1, fp) == 1
+		  && fwrite(refs, sizeof(node_ref), 5, fp) == 5
+		  && (!links::split_trees || fwrite(trees, sizeof(tree), node_num, fp) == (size_t) node_num)
+		  && (bucket_num == 0 || (fwrite(bucket_first, sizeof(node_ref), bucket_num, fp) == (size_t) bucket_num
+		                       && fwrite(bucket_last, sizeof(node_ref), bucket_num, fp) == (size_t) bucket_num));
+	}
+	if (fclose(fp) != 0) ok = false;
+	if (!ok) { if (error_function) (*error_function)("Cannot write the graph file!"); exit(1); }
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	typename Graph<captype,tcaptype,flowtype,layout,schedule>::node_ref Graph<captype,tcaptype,flowtype,layout,schedule>::read_graph_file(const char* filename, bool with_state)
+{
+	graph_file_header h, t;
+	graph_file_state st;
+	node_ref refs[5] = { 0, 0, 0, 0, 0 };
+	node* i;
+	arc* a;
+	int k;
+	FILE* fp = fopen(filename, "rb");
+	if (!fp) { if (error_function) (*error_function)("Cannot open the graph file!"); exit(1); }
+
+	if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, "BKGRAPH", 8) || h.version != GRAPH_FILE_VERSION)
+	{ if (error_function) (*error_function)("Not a graph file of this version!"); exit(1); }
+	if (h.byte_order != GRAPH_FILE_BYTE_ORDER) { if (error_function) (*error_function)("Graph file of another byte order!"); exit(1); }
+	graph_file_type<captype,tcaptype,flowtype,layout>(t);
+	if (h.layout != t.layout || memcmp(h.sizes, t.sizes, 3*sizeof(int32_t)) || h.integer_types != t.integer_types
+	 || h.sizes[3] != (int32_t) sizeof(node) || h.sizes[4] != (int32_t) sizeof(arc))
+	{ if (error_function) (*error_function)("Graph file of another graph type!"); exit(1); }
+	if (with_state && !h.has_state) { if (error_function) (*error_function)("Not a checkpoint file!"); exit(1); }
+
+	/* an empty graph with room for the nodes and arcs of the file */
+	reset();
+	free(tcaps);
+	free(caps);
+	tcaps = NULL;
+	caps = NULL;
+	if (h.node_num > node_max - nodes)
+	{
+		free(nodes);
+		free(trees);
+		nodes = (node*) malloc(h.node_num*sizeof(node));
+		trees = (links::split_trees) ? (tree*) malloc(h.node_num*sizeof(tree)) : NULL;
+		if (!nodes || (links::split_trees && !trees)) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+		node_max = nodes + h.node_num;
+	}
+	if (h.arc_num > arc_max - arcs)
+	{
+		free(arcs);
+		arcs = (arc*) malloc(h.arc_num*sizeof(arc));
+		if (!arcs) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+		arc_max = arcs + h.arc_num;
+	}
+	if (h.has_caps)
+	{
+		tcaps = (tcaptype*) malloc(2*(node_max - nodes)*sizeof(tcaptype));
+		caps = (captype*) malloc((arc_max - arcs)*sizeof(captype));
+		if (!tcaps || !caps) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	}
+	if (h.has_node_pos)
+	{
+		node_pos = (node_id*) malloc((node_max - nodes)*sizeof(node_id));
+		node_order = (node_id*) malloc((node_max - nodes)*sizeof(node_id));
+		if (!node_pos || !node_order) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	}
+
+	bool ok = fread(nodes, sizeof(node), h.node_num, fp) == (size_t) h.node_num
+	       && fread(arcs, sizeof(arc), h.arc_num, fp) == (size_t) h.arc_num;
+	if (ok && tcaps)
+	{
+		ok = fread(tcaps, sizeof(tcaptype), 2*h.node_num, fp) == (size_t) 2*h.node_num
+		  && fread(caps, sizeof(captype), h.arc_num, fp) == (size_t) h.arc_num;
+	}
+	if (ok && node_pos)
+	{
+		ok = fread(node_pos, sizeof(node_id), h.node_num, fp) == (size_t) h.node_num
+		  && fread(node_order, sizeof(node_id), h.node_num, fp) == (size_t) h.node_num;
+	}
+	ok = ok && fread(&flow, sizeof(flowtype), 1, fp) == 1;
+	if (ok && with_state)
+	{
+		ok = fread(&st, sizeof(st), 1, fp) == 1
+		  && fread(refs, sizeof(node_ref), 5, fp) == 5
+		  && (!links::split_trees || fread(trees, sizeof(tree), h.node_num, fp) == (size_t) h.node_num);
+		if (ok)
+		{
+			/* the buckets exist only with GRAPH_DISTANCE (bucket_num > 0) */
+			free(bucket_first);
+			free(bucket_last);
+			bucket_first = bucket_last = NULL;
+			if (st.bucket_num > 0)
+			{
+				bucket_first = (node_ref*) malloc(st.bucket_num*sizeof(node_ref));
+				bucket_last = (node_ref*) malloc(st.bucket_num*sizeof(node_ref));
+				if (!bucket_first || !bucket_last) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+				ok = fread(bucket_first, sizeof(node_ref), st.bucket_num, fp) == (size_t) st.bucket_num
+				  && fread(bucket_last, sizeof(node_ref), st.bucket_num, fp) == (size_t) st.bucket_num;
+			}
+		}
+	}
+	fclose(fp);
+	if (!ok) { if (error_function) (*error_function)("Cannot read the graph file!"); exit(1); }
+
+	node_num = h.node_num;
+	node_last = nodes + node_num;
+	arc_last = arcs + h.arc_num;
+	arcs_reordered = (h.arcs_reordered != 0);
+
+	/*
+		links saved as addresses point into the arrays of the saving process;
+		without the state, the search trees are built by the next maxflow()
+	*/
+	ptrdiff_t node_delta = ((char*) nodes) - ((char*) (uintptr_t) h.nodes_base);
+	ptrdiff_t arc_delta = ((char*) arcs) - ((char*) (uintptr_t) h.arcs_base);
+	for (i=nodes; i<node_last; i++)
+	{
+		if (links::need_shift && i->first) i->first = links::shift_arc(i->first, arc_delta);
+		arc_ref& parent = T(NREF(i)).parent;
+		if (!with_state)
+		{
+			i->next = 0;
+			i->is_marked = 0;
+			i->is_in_changed_list = 0;
+			i->is_fixed = 0;
+			parent = 0;
+		}
+		else if (links::need_shift)
+		{
+			if (i->next) i->next = links::shift_node(i->next, node_delta);
+			if (parent && parent != ORPHAN && parent != TERMINAL) parent = links::shift_arc(parent, arc_delta);
+		}
+	}
+	if (links::need_shift)
+	{
+		for (a=arcs; a<arc_last; a++)
+		{
+			a->head = links::shift_node(a->head, node_delta);
+			if (a->next) a->next = links::shift_arc(a->next, arc_delta);
+			a->sister = links::shift_arc(a->sister, arc_delta);
+		}
+	}
+	if (!with_state)
+	{
+		maxflow_iteration = 0;
+		return 0;
+	}
+
+	if (links::need_shift)
+	{
+		for (k=0; k<5; k++)
+		{
+			if (refs[k]) refs[k] = links::shift_node(refs[k], node_delta);
+		}
+		for (k=0; k<st.bucket_num; k++)
+		{
+			if (bucket_first[k]) bucket_first[k] = links::shift_node(bucket_first[k], node_delta);
+			if (bucket_last[k]) bucket_last[k] = links::shift_node(bucket_last[k], node_delta);
+		}
+	}
+	TIME = st.TIME;
+	maxflow_iteration = st.maxflow_iteration;
+	alternate = st.alternate;
+	bucket_num = st.bucket_num;
+	bucket_min = st.bucket_min;
+	bucket_max = st.bucket_max;
+	queue_first[0] = refs[1];
+	queue_first[1] = refs[2];
+	queue_last[0] = refs[3];
+	queue_last[1] = refs[4];
+	return refs[0];
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::reallocate_nodes(int num)
 {
 	int node_num_max = (int)(node_max - nodes);
 	node* nodes_old = nodes;
@@ -73,27 +599,44 @@ template <typename captype, typename tcaptype, typename flowtype>
 	if (node_num_max < node_num + num) node_num_max = node_num + num;
 	nodes = (node*) realloc(nodes_old, node_num_max*sizeof(node));
 	if (!nodes) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	if (links::split_trees)
+	{
+		trees = (tree*) realloc(trees, node_num_max*sizeof(tree));
+		if (!trees) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	}
+	if (tcaps)
+	{
+		tcaps = (tcaptype*) realloc(tcaps, 2*node_num_max*sizeof(tcaptype));
+		if (!tcaps) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	}
+	if (node_pos)
+	{
+		node_pos = (node_id*) realloc(node_pos, node_num_max*sizeof(node_id));
+		node_order = (node_id*) realloc(node_order, node_num_max*sizeof(node_id));
+		if (!node_pos || !node_order) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	}
 
 	node_last = nodes + node_num;
 	node_max = nodes + node_num_max;
 
-	if (nodes != nodes_old)
+	if (links::need_shift && nodes != nodes_old)
 	{
 		node* i;
 		arc* a;
+		ptrdiff_t delta = ((char*) nodes) - ((char*) nodes_old);
 		for (i=nodes; i<node_last; i++)
 		{
-			if (i->next) i->next = (node*) ((char*)i->next + (((char*) nodes) - ((char*) nodes_old)));
+			if (i->next) i->next = links::shift_node(i->next, delta);
 		}
 		for (a=arcs; a<arc_last; a++)
 		{
-			a->head = (node*) ((char*)a->head + (((char*) nodes) - ((char*) nodes_old)));
+			a->head = links::shift_node(a->head, delta);
 		}
 	}
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::reallocate_arcs()
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::reallocate_arcs()
 {
 	int arc_num_max = (int)(arc_max - arcs);
 	int arc_num = (int)(arc_last - arcs);
@@ -102,25 +645,167 @@ template <typename captype, typename tcaptype, typename flowtype>
 	arc_num_max += arc_num_max / 2; if (arc_num_max & 1) arc_num_max ++;
 	arcs = (arc*) realloc(arcs_old, arc_num_max*sizeof(arc));
 	if (!arcs) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	if (caps)
+	{
+		caps = (captype*) realloc(caps, arc_num_max*sizeof(captype));
+		if (!caps) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	}
 
 	arc_last = arcs + arc_num;
 	arc_max = arcs + arc_num_max;
 
-	if (arcs != arcs_old)
+	if (links::need_shift && arcs != arcs_old)
 	{
 		node* i;
 		arc* a;
+		ptrdiff_t delta = ((char*) arcs) - ((char*) arcs_old);
 		for (i=nodes; i<node_last; i++)
 		{
-			if (i->first) i->first = (arc*) ((char*)i->first + (((char*) arcs) - ((char*) arcs_old)));
-			if (i->parent && i->parent != ORPHAN && i->parent != TERMINAL) i->parent = (arc*) ((char*)i->parent + (((char*) arcs) - ((char*) arcs_old)));
+			if (i->first) i->first = links::shift_arc(i->first, delta);
+			arc_ref& parent = T(NREF(i)).parent;
+			if (parent && parent != ORPHAN && parent != TERMINAL) parent = links::shift_arc(parent, delta);
 		}
 		for (a=arcs; a<arc_last; a++)
 		{
-			if (a->next) a->next = (arc*) ((char*)a->next + (((char*) arcs) - ((char*) arcs_old)));
-			a->sister = (arc*) ((char*)a->sister + (((char*) arcs) - ((char*) arcs_old)));
+			if (a->next) a->next = links::shift_arc(a->next, delta);
+			a->sister = links::shift_arc(a->sister, delta);
 		}
 	}
 }
 
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::track_capacities()
+{
+	assert(node_num == 0 && arc_last == arcs);
+
+	if (tcaps) return;
+	tcaps = (tcaptype*) malloc(2*(node_max - nodes)*sizeof(tcaptype));
+	caps = (captype*) malloc((arc_max - arcs)*sizeof(captype));
+	if (!tcaps || !caps) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::edit_tweights(node_id _i, tcaptype new_cap_source, tcaptype new_cap_sink)
+{
+	assert(_i >= 0 && _i < node_num);
+	if (!tcaps) { if (error_function) (*error_function)("edit_tweights() needs track_capacities()!"); exit(1); }
+
+	node_id i = node_index(_i);
+
+	/* residual capacities of SOURCE->i and i->SINK after the edit */
+	tcaptype tr_cap = nodes[i].tr_cap;
+	tcaptype cap_source = ((tr_cap > 0) ? tr_cap : 0) + new_cap_source - tcaps[2*i];
+	tcaptype cap_sink = ((tr_cap < 0) ? -tr_cap : 0) + new_cap_sink - tcaps[2*i+1];
+	tcaps[2*i]   = new_cap_source;
+	tcaps[2*i+1] = new_cap_sink;
+
+	/*
+		if more flow goes through a t-link than its new capacity, the excess
+		is added to the capacities of both t-links (which changes the cost of
+		every cut by the same amount) and subtracted from the flow
+	*/
+	if (cap_source < 0) { cap_sink -= cap_source; flow += cap_source; cap_source = 0; }
+	if (cap_sink < 0)   { cap_source -= cap_sink; flow += cap_sink;   cap_sink = 0; }
+	flow += (cap_source < cap_sink) ? cap_source : cap_sink;
+	nodes[i].tr_cap = cap_source - cap_sink;
+
+	if (maxflow_iteration > 0) mark_node(_i);
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::edit_edge(arc_id a, captype new_cap, captype new_rev_cap)
+{
+	assert(a >= arcs && a < arc_last);
+	assert(new_cap >= 0);
+	assert(new_rev_cap >= 0);
+	if (!caps) { if (error_function) (*error_function)("edit_edge() needs track_capacities()!"); exit(1); }
+
+	arc* a_rev = &A(a->sister);
+	node_id i, j;
+	get_arc_ends(a, i, j);
+
+	/*
+		the new residual capacities may be negative, which an unsigned captype
+		cannot hold: they are computed in tcaptype, signed and larger than captype
+	*/
+	tcaptype r_cap = (tcaptype) a->r_cap + (tcaptype) new_cap - (tcaptype) caps[a - arcs];
+	tcaptype rev_r_cap = (tcaptype) a_rev->r_cap + (tcaptype) new_rev_cap - (tcaptype) caps[a_rev - arcs];
+	caps[a - arcs] = new_cap;
+	caps[a_rev - arcs] = new_rev_cap;
+
+	/*
+		if the flow i->j is now larger than the capacity of a by 'excess', then
+		c*[i in S, j in T] = (c+excess)*[i in S, j in T] - excess*[i in T, j in S]
+		                     + excess*[i in T] + excess*[j in S] - excess:
+		a is kept saturated, its sister gives up 'excess' and the excess goes to
+		SOURCE->i and j->SINK. Similarly for the flow j->i.
+	*/
+	if (r_cap < 0)
+	{
+		tcaptype excess = -r_cap;
+		r_cap = 0;
+		rev_r_cap -= excess;
+		add_tweights(i, excess, 0);
+		add_tweights(j, 0, excess);
+		flow -= excess;
+		tcaps[2*node_index(i)] -= excess; tcaps[2*node_index(j)+1] -= excess; /* not a change of the capacities given by the user */
+	}
+	else if (rev_r_cap < 0)
+	{
+		tcaptype excess = -rev_r_cap;
+		rev_r_cap = 0;
+		r_cap -= excess;
+		add_tweights(j, excess, 0);
+		add_tweights(i, 0, excess);
+		flow -= excess;
+		tcaps[2*node_index(j)] -= excess; tcaps[2*node_index(i)+1] -= excess;
+	}
+	a->r_cap = (captype) r_cap;
+	a_rev->r_cap = (captype) rev_r_cap;
+
+	if (maxflow_iteration > 0)
+	{
+		mark_node(i);
+		mark_node(j);
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::export_segmentation(unsigned char* out, unsigned char source_value, unsigned char sink_value, termtype default_segm, node_id first, int num)
+{
+	if (num < 0) num = node_num - first;
+	assert(first >= 0 && first + num <= node_num);
+
+	/* values[is_sink] for nodes in a tree, default_value for free nodes */
+	const unsigned char values[2] = { source_value, sink_value };
+	const unsigned char default_value = (default_segm == SOURCE) ? source_value : sink_value;
+
+	for (int k=0; k<num; k++)
+	{
+		node_ref j = NREF(nodes + node_index(first + k));
+		out[k] = (T(j).parent) ? values[T(j).is_sink & 1] : default_value;
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::export_segmentation_bits(unsigned char* bits, termtype one_segm, termtype default_segm, node_id first, int num)
+{
+	if (num < 0) num = node_num - first;
+	assert(first >= 0 && first + num <= node_num);
+
+	/* a node in a tree gets bit is_sink, flipped if one_segm is SOURCE */
+	const unsigned char flip = (one_segm == SOURCE) ? 1 : 0;
+	const unsigned char default_bit = (default_segm == one_segm) ? 1 : 0;
+	unsigned char byte = 0;
+
+	for (int k=0; k<num; k++)
+	{
+		node_ref j = NREF(nodes + node_index(first + k));
+		unsigned char b = (T(j).parent) ? (unsigned char)((T(j).is_sink & 1) ^ flip) : default_bit;
+		byte |= b << (k & 7);
+		if ((k & 7) == 7) { bits[k >> 3] = byte; byte = 0; }
+	}
+	if (num & 7) bits[num >> 3] = byte;
+}
+
 #include "instances.inc"
@@ -60,7 +60,9 @@
 #ifndef __GRAPH_H__
 #define __GRAPH_H__
 
+#include <stddef.h>
 #include <string.h>
+#include <stdint.h>
 #include "block.h"
 
 #include <assert.h>
@@ -68,12 +70,128 @@
 
 
 
+// Memory layouts of the graph (see the 'layout' template argument below).
+//
+// GRAPH_POINTERS: nodes and arcs are linked with pointers, as in version 3.03.
+//
+// GRAPH_INDICES: nodes and arcs are linked with 32-bit indices. On 64-bit machines
+//   this halves the size of the links (and of the whole graph for integer capacities),
+//   and the links do not need to be rewritten when the arrays are reallocated.
+//
+// GRAPH_INDICES_SPLIT: 32-bit indices as GRAPH_INDICES, and the state of the search
+//   trees (parent, TS, DIST, is_sink) is kept in an array of its own, apart from
+//   the adjacency and the residual capacities. The tree walks of maxflow()
+//   (growth, origin checks of orphans) then read 16 bytes per node instead of
+//   a whole node record.
+enum
+{
+	GRAPH_POINTERS		= 0,
+	GRAPH_INDICES		= 1,
+	GRAPH_INDICES_SPLIT	= 2
+};
+
+// Order in which maxflow() grows the active nodes of the search trees (see the
+// 'schedule' template argument below). The cut is the same with all of them;
+// the lengths of the augmenting paths and the number of orphans are not.
+//
+// GRAPH_FIFO: first in, first out, as in version 3.03.
+//
+// GRAPH_LIFO: last in, first out: a tree grows from the node it reached last.
+//
+// GRAPH_DISTANCE: the active node with the smallest distance to its terminal
+//   (DIST) first, first in, first out among nodes of the same distance.
+//
+// GRAPH_ALTERNATE: one queue per tree, first in, first out, and the two trees
+//   grow a node in turn.
+enum
+{
+	GRAPH_FIFO			= 0,
+	GRAPH_LIFO			= 1,
+	GRAPH_DISTANCE		= 2,
+	GRAPH_ALTERNATE		= 3
+};
+
+// Links between nodes and arcs for a given layout:
+//   node_ref, arc_ref    types of the links
+//   node_ptr(), arc_ptr()    give the node (arc) a link refers to
+//   node_ref_of(), arc_ref_of()    give the link referring to a node (arc)
+//   shift_node(), shift_arc()    rewrite a link after its array moved by 'delta' bytes
+//   split_trees    true if the tree state is stored apart from the nodes
+// In both layouts the link 0 means "none", and the arc links 1 and 2 are
+// reserved for the special values TERMINAL and ORPHAN (see maxflow.cpp).
+template <typename node, typename arc, int layout> struct GraphLinks;
+
+template <typename node, typename arc> struct GraphLinks<node, arc, GRAPH_POINTERS>
+{
+	typedef node* node_ref;
+	typedef arc* arc_ref;
+
+	static node* node_ptr(node*, node_ref i) { return i; }
+	static arc* arc_ptr(arc*, arc_ref a) { return a; }
+	static node_ref node_ref_of(node*, node* i) { return i; }
+	static arc_ref arc_ref_of(arc*, arc* a) { return a; }
+
+	static const bool need_shift = true;
+	static node_ref shift_node(node_ref i, ptrdiff_t delta) { return (node*) ((char*)i + delta); }
+	static arc_ref shift_arc(arc_ref a, ptrdiff_t delta) { return (arc*) ((char*)a + delta); }
+
+	static const bool split_trees = false;
+};
+
+template <typename node, typename arc> struct GraphLinks<node, arc, GRAPH_INDICES>
+{
+	typedef uint32_t node_ref; // node nodes[k] is referred to as k+1
+	typedef uint32_t arc_ref;  // arc arcs[k] is referred to as k+3
+
+	static node* node_ptr(node* nodes, node_ref i) { return nodes + i - 1; }
+	static arc* arc_ptr(arc* arcs, arc_ref a) { return arcs + a - 3; }
+	static node_ref node_ref_of(node* nodes, node* i) { return (node_ref) (i - nodes) + 1; }
+	static arc_ref arc_ref_of(arc* arcs, arc* a) { return (arc_ref) (a - arcs) + 3; }
+
+	static const bool need_shift = false;
+	static node_ref shift_node(node_ref i, ptrdiff_t) { return i; }
+	static arc_ref shift_arc(arc_ref a, ptrdiff_t) { return a; }
+
+	static const bool split_trees = false;
+};
+
+template <typename node, typename arc> struct GraphLinks<node, arc, GRAPH_INDICES_SPLIT>
+	: public GraphLinks<node, arc, GRAPH_INDICES>
+{
+	static const bool split_trees = true;
+};
+
+// Storage of the tree state of a node.
+// If the tree state is not split, the node derives from the tree fields and is its own
+// tree record; otherwise the record of nodes[k] is trees[k].
+template <typename fields, bool split> struct GraphNodeTree : public fields {};
+template <typename fields> struct GraphNodeTree<fields, true> {};
+
+template <typename node, typename tree, bool split> struct GraphTreeState
+{
+	typedef node type;
+	static type& get(node*, tree*, node* i) { return *i; }
+};
+
+template <typename node, typename tree> struct GraphTreeState<node, tree, true>
+{
+	typedef tree type;
+	static type& get(node* nodes, tree* trees, node* i) { return trees[i - nodes]; }
+};
+
+
+
+// solves parts of a Graph concurrently (see parallelgraph.h)
+template <typename captype, typename tcaptype, typename flowtype, int layout> class ParallelGraph;
+
 // captype: type of edge capacities (excluding t-links)
 // tcaptype: type of t-links (edges between nodes and terminals)
 // flowtype: type of total flow
+// layout: GRAPH_POINTERS, GRAPH_INDICES or GRAPH_INDICES_SPLIT (see above)
+// schedule: GRAPH_FIFO, GRAPH_LIFO, GRAPH_DISTANCE or GRAPH_ALTERNATE (see above)
 //
 // Current instantiations are in instances.inc
-template <typename captype, typename tcaptype, typename flowtype> class Graph
+template <typename captype, typename tcaptype, typename flowtype, int layout = GRAPH_POINTERS, int schedule = GRAPH_FIFO> class Graph
 {
 public:
 	typedef enum
@@ -128,6 +246,27 @@ public:
 	// FOR DESCRIPTION OF changed_list, SEE remove_from_changed_list().
 	flowtype maxflow(bool reuse_trees = false, Block<node_id>* changed_list = NULL);
 
+	// Flow found so far: the value returned by the last maxflow(), plus the
+	// flow add_tweights() and edit_tweights() added since (the smaller of the
+	// two capacities of a node goes straight from the source to the sink).
+	flowtype get_flow() { return flow; }
+
+	// Fixes the nodes whose segment does not depend on the other nodes,
+	// before a call to maxflow() without reuse_trees: a node whose source
+	// t-link has at least the residual capacity of its outgoing arcs is in
+	// the SOURCE segment, a node whose sink t-link has at least the residual
+	// capacity of its incoming arcs is in the SINK segment. The arcs of a
+	// fixed node are saturated, which moves their capacity to the t-links of
+	// its neighbours, so a node may be fixed by those visited before it (the
+	// nodes are visited once, in order). The next maxflow() with BK puts the
+	// fixed nodes in their search tree without growing it from them: only the
+	// rest of the graph is searched. Flow, cut and what_segment() are the same
+	// as without this call. Returns the number of fixed nodes.
+	//
+	// NOTE: a t-link may grow by the capacities of the arcs of its node, which
+	//       tcaptype must hold.
+	int fix_persistent_nodes();
+
 	// After the maxflow is computed, this function returns to which
 	// segment the node 'i' belongs (Graph<captype,tcaptype,flowtype>::SOURCE or Graph<captype,tcaptype,flowtype>::SINK).
 	//
@@ -135,6 +274,22 @@ public:
 	// to both the source and the sink, then default_segm is returned.
 	termtype what_segment(node_id i, termtype default_segm = SOURCE);
 
+	// Same as what_segment() for the nodes first, ..., first+num-1 in one pass
+	// (num<0: up to the last node): out[k] is set to source_value if node first+k
+	// is in the SOURCE segment and to sink_value if it is in the SINK segment
+	// (swap the two values to get the inverted mask).
+	// Calls on disjoint ranges of nodes can be made from several threads at once,
+	// e.g. one per band of rows of an image.
+	void export_segmentation(unsigned char* out, unsigned char source_value, unsigned char sink_value,
+	                         termtype default_segm = SOURCE, node_id first = 0, int num = -1);
+
+	// Same as export_segmentation(), packed in a bit array: bit (k%8) of bits[k/8]
+	// is 1 if node first+k is in segment one_segm and 0 otherwise.
+	// For calls from several threads, 'first' of each range must be a multiple of 8
+	// and the range must write at bits + first/8.
+	void export_segmentation_bits(unsigned char* bits, termtype one_segm = SINK,
+	                              termtype default_segm = SOURCE, node_id first = 0, int num = -1);
+
 
 
 	//////////////////////////////////////////////
@@ -146,6 +301,10 @@ private:
 	struct node;
 	struct arc;
 
+	typedef GraphLinks<node, arc, layout> links;
+	typedef typename links::node_ref node_ref;
+	typedef typename links::arc_ref arc_ref;
+
 public:
 
 	////////////////////////////
@@ -163,6 +322,79 @@ public:
 	// (see functions below).
 	void reset();
 
+	// Removes the capacities of all t-links and edges, and the flow, but
+	// keeps the nodes and the arcs: the graph is as if the same add_node()
+	// and add_edge() calls had been made with zero capacities. The new
+	// capacities are then given with add_tweights() and set_edge(), which
+	// only write them.
+	//
+	// Useful if the structure of the graph is the same for many problems
+	// (e.g. images of the same size): no arc list is built again.
+	void reset_capacities();
+
+	// Sets the capacities of the edge added by add_edge(i,j,cap,rev_cap) whose first arc is 'a'
+	// (see get_first_arc()). Must be used only after reset_capacities(), before maxflow().
+	void set_edge(arc* a, captype cap, captype rev_cap);
+
+	// Reorders the arcs so that the arcs out of each node are contiguous, in
+	// the order of the nodes (compressed sparse row order), which makes the
+	// scans of the arcs of a node during maxflow() walk through memory.
+	// Meant to be called once after the graph is built, before maxflow():
+	// grids built row by row already have nearly this order, graphs built
+	// in an arbitrary order (meshes, superpixels) gain most.
+	//
+	// NOTE:
+	//   - arc_ids obtained before the call are invalid after it, and
+	//     get_first_arc()/get_next_arc() no longer return the arcs in the order
+	//     they were added (nor an arc next to its reverse arc);
+	//   - the arcs are copied, so memory for a second copy is needed during the call;
+	//   - arcs added later are not ordered (call finalize() again).
+	void finalize();
+
+	// Moves the nodes in memory so that nodes[k] is the node order[k]
+	// (order must be a permutation of 0..get_node_num()-1), then calls
+	// finalize(). Node ids are unchanged for all functions of the interface:
+	// they are mapped to the new positions, at the cost of two ints per node.
+	// Neighbours placed close to each other (e.g. pixels along a Morton
+	// curve, see grid_morton_order() in image_graph.h) make the tree walks of
+	// maxflow() touch fewer cache lines and pages.
+	// Without argument, the order is a breadth-first search of the graph.
+	//
+	// NOTE: must be called before the first call to maxflow(). See finalize() about arc_ids.
+	void reorder_nodes(const node_id* order);
+	void reorder_nodes();
+
+	// Writes the graph to file 'filename': its nodes and arcs as they are in
+	// memory (residual capacities, order given by finalize() or
+	// reorder_nodes(), capacities of track_capacities()) and the flow, after
+	// a header with a version and the byte order.
+	//
+	// load() replaces the graph by the one of the file in one bulk read per
+	// array, instead of the add_node(), add_edge() and add_tweights() calls
+	// that built it. The file must come from a Graph of the same template
+	// arguments (the schedule aside) on a machine of the same byte order.
+	// The search trees are not saved: after load(), maxflow() must be called
+	// without reuse_trees first. If the graph was saved after maxflow(), the
+	// next maxflow() returns the same flow.
+	void save(const char* filename);
+	void load(const char* filename);
+
+	// Checkpoints of long maxflow() calls. After set_checkpoint(filename, seconds),
+	// maxflow() writes the whole state of the solver (the graph as save() does,
+	// plus the search trees, the active nodes and the flow) to 'filename' every
+	// 'seconds' seconds or so (between two growth steps of BK; not during the
+	// phase of HPF or IBFS). The file is written next to 'filename' and then
+	// renamed, so that a job stopped while writing keeps its previous checkpoint;
+	// the last checkpoint is left for the caller to delete.
+	// set_checkpoint(NULL) stops the checkpoints.
+	//
+	// resume(filename) replaces the graph by the one of a checkpoint file, with
+	// the same conditions as load(), and continues the maxflow() call that wrote
+	// it: it returns the flow that call would have returned. The changed_list of
+	// that call, if any, is not kept.
+	void set_checkpoint(const char* filename, int seconds);
+	flowtype resume(const char* filename);
+
 	////////////////////////////////////////////////////////////////////////////////
 	// 2. Functions for getting pointers to arcs and for reading graph structure. //
 	//    NOTE: adding new arcs may invalidate these pointers (if reallocation    //
@@ -174,13 +406,19 @@ public:
 	// the first arc returned will be i->j, and the second j->i.
 	// If there are no more arcs, then the function can still be called, but
 	// the returned arc_id is undetermined.
+	// Not after finalize() or reorder_nodes(): see arcs_in_add_order().
 	typedef arc* arc_id;
 	arc_id get_first_arc();
 	arc_id get_next_arc(arc_id a);
+	// false once finalize() or reorder_nodes() has reordered the arcs (until reset())
+	bool arcs_in_add_order() { return !arcs_reordered; }
 
 	// other functions for reading graph structure
 	int get_node_num() { return node_num; }
 	int get_arc_num() { return (int)(arc_last - arcs); }
+	// bytes used by the nodes and the arcs added so far (and their tree states)
+	size_t get_memory_size() { return node_num*(sizeof(node) + (links::split_trees ? sizeof(tree) : 0) + (tcaps ? 2*sizeof(tcaptype) : 0) + (node_pos ? 2*sizeof(node_id) : 0))
+	                                  + get_arc_num()*(sizeof(arc) + (caps ? sizeof(captype) : 0)); }
 	void get_arc_ends(arc_id a, node_id& i, node_id& j); // returns i,j to that a = i->j
 
 	///////////////////////////////////////////////////
@@ -264,10 +502,96 @@ public:
 	//    is not necessary. ("changed_list->Reset()" or "delete changed_list" should still be called, though).
 	void remove_from_changed_list(node_id i) 
 	{ 
-		assert(i>=0 && i<node_num && nodes[i].is_in_changed_list); 
-		nodes[i].is_in_changed_list = 0;
+		assert(i>=0 && i<node_num && nodes[node_index(i)].is_in_changed_list); 
+		nodes[node_index(i)].is_in_changed_list = 0;
 	}
 
+	/////////////////////////////////////////////////////////////////////
+	// 6. Functions for editing capacities between calls to maxflow(). //
+	/////////////////////////////////////////////////////////////////////
+
+	// edit_tweights() and edit_edge() replace the capacities of t-links and
+	// edges by new values. Unlike set_trcap() and set_rcap(), they keep the
+	// flow computed so far: the residual capacities and the value of the flow
+	// are adjusted by the difference between the new and the old capacities,
+	// and the nodes involved are passed to mark_node(). So the graph can be
+	// edited and maxflow(true) called directly; its cost is then in
+	// proportion to the change, not to the size of the graph.
+	//
+	// The old capacities are the sums of the weights given to add_tweights()
+	// (resp. the weights given to add_edge()) and to previous edits. The graph
+	// keeps them only if track_capacities() is called, before any node is
+	// added. This costs 2 tcaptype per node and 1 captype per arc.
+	//
+	// NOTE:
+	//   - a decrease below the flow already sent through a t-link or an arc
+	//     is handled as well (the excess is moved to the t-links of its ends);
+	//   - do not mix edits with set_trcap() or set_rcap().
+	void track_capacities();
+	void edit_tweights(node_id i, tcaptype new_cap_source, tcaptype new_cap_sink);
+	void edit_edge(arc_id a, captype new_cap, captype new_rev_cap); // a is i->j, new_rev_cap goes to j->i
+
+	/////////////////////////////////////////////////////////////////
+	// 7. Statistics of maxflow() (if compiled with MAXFLOW_STATS) //
+	/////////////////////////////////////////////////////////////////
+
+#ifdef MAXFLOW_STATS
+	// Counts and times of the last call to maxflow(), to relate the running
+	// time on an input to the behaviour of the algorithm. Without MAXFLOW_STATS
+	// nothing is counted and this interface does not exist.
+	struct maxflow_stats
+	{
+		long long	growth_steps;		// active nodes whose arcs were scanned
+		long long	augmentations;		// augmenting paths found
+		long long	path_length;		// arcs of all augmenting paths (not counting t-links)
+		int			max_path_length;	// arcs of the longest augmenting path
+		long long	orphans;			// orphans processed
+		long long	origin_walk;		// arcs followed to find the origin of a possible parent of an orphan
+		long long	orphan_pushes;		// nodes added to the orphan queue
+		int			orphan_queue_size;	// items the orphan queue can hold (kept from one call to the next)
+
+		double		algorithm_time;		// seconds spent in the algorithm chosen with set_algorithm(), if not BK
+		double		init_time;			// seconds spent in maxflow_init() or maxflow_reuse_trees_init()
+		double		growth_time;		// seconds spent growing the trees
+		double		augment_time;		// seconds spent augmenting
+		double		adoption_time;		// seconds spent adopting orphans after augmentations
+	};
+	const maxflow_stats& get_stats() { return stats; }
+#endif
+
+	////////////////////////////////////////////
+	// 8. Choice of the maxflow algorithm     //
+	////////////////////////////////////////////
+
+	// maxflow() computes the flow with the algorithm of Boykov and Kolmogorov
+	// (BK, the default). With HPF or IBFS, a call to maxflow() without
+	// reuse_trees first runs another algorithm on the residual graph:
+	//   HPF:  the pseudoflow algorithm of Hochbaum, highest label variant
+	//         (pseudoflow.cpp);
+	//   IBFS: the incremental breadth-first search algorithm of Goldberg et al.,
+	//         whose search trees have exact distance labels (ibfs.cpp);
+	// then builds the search trees of BK on its result. This last step finds
+	// no augmenting path, so what_segment(), the reuse of trees and
+	// changed_list work as with BK, and give the same answers.
+	//
+	// BK is faster on image grids, where augmenting paths are short. HPF is
+	// faster on graphs with many long-range edges (4-10 times on random graphs
+	// of 50000-200000 nodes and degree 10-30), and on grids with a strong
+	// smoothness term; IBFS is 2-4 times faster than BK on the former, slower
+	// on grids (see algorithm_benchmark.cpp). During the call to maxflow(),
+	// HPF needs 40-56 bytes more per node, IBFS 20-28.
+	//
+	// NOTE: calls to maxflow(true, ...) always use BK, since the trees
+	// to be reused are those of BK.
+	typedef enum
+	{
+		BK		= 0,
+		HPF		= 1,
+		IBFS	= 2
+	} algotype;
+	void set_algorithm(algotype a) { algorithm = a; }
+	algotype get_algorithm() { return algorithm; }
+
 
 
 
@@ -280,18 +604,30 @@ public:
 private:
 	// internal variables and functions
 
-	struct node
+	// state of the search trees, read and written by the tree walks of maxflow()
+	struct tree_fields
 	{
-		arc			*first;		// first outcoming arc
-
-		arc			*parent;	// node's parent
-		node		*next;		// pointer to the next active node
-								//   (or to itself if it is the last node in the list)
+		arc_ref		parent;		// node's parent
 		int			TS;			// timestamp showing when DIST was computed
 		int			DIST;		// distance to the terminal
+	};
+
+	struct tree : public tree_fields
+	{
+		int			is_sink : 1;	// see node::is_sink
+	};
+
+	struct node : public GraphNodeTree<tree_fields, links::split_trees>
+	{
+		arc_ref		first;		// first outcoming arc
+
+		node_ref	next;		// pointer to the next active node
+								//   (or to itself if it is the last node in the list)
 		int			is_sink : 1;	// flag showing whether the node is in the source or in the sink tree (if parent!=NULL)
+								//   (unused if the tree state is split)
 		int			is_marked : 1;	// set by mark_node()
 		int			is_in_changed_list : 1; // set by maxflow if 
+		int			is_fixed : 1;	// set by fix_persistent_nodes(), cleared by the next maxflow()
 
 		tcaptype	tr_cap;		// if tr_cap > 0 then tr_cap is residual capacity of the arc SOURCE->node
 								// otherwise         -tr_cap is residual capacity of the arc node->SINK 
@@ -300,26 +636,36 @@ private:
 
 	struct arc
 	{
-		node		*head;		// node the arc points to
-		arc			*next;		// next arc with the same originating node
-		arc			*sister;	// reverse arc
+		node_ref	head;		// node the arc points to
+		arc_ref		next;		// next arc with the same originating node
+		arc_ref		sister;		// reverse arc
 
 		captype		r_cap;		// residual capacity
 	};
 
-	struct nodeptr
-	{
-		node    	*ptr;
-		nodeptr		*next;
-	};
-	static const int NODEPTR_BLOCK_SIZE = 128;
+	static const int ORPHAN_QUEUE_SIZE = 128; // initial size of the orphan queue
+	static const int CHECKPOINT_STEPS = 1024; // growth steps between two looks at the clock for set_checkpoint()
 
 	node				*nodes, *node_last, *node_max; // node_last = nodes+node_num, node_max = nodes+node_num_max;
+	tree				*trees;		// tree state of the nodes if split_trees, NULL otherwise
 	arc					*arcs, *arc_last, *arc_max; // arc_last = arcs+2*edge_num, arc_max = arcs+2*edge_num_max;
 
+	// capacities of the graph if track_capacities() was called, NULL otherwise
+	tcaptype			*tcaps;		// SOURCE->nodes[k] is tcaps[2*k], nodes[k]->SINK is tcaps[2*k+1]
+	captype				*caps;		// capacity of arcs[k] is caps[k]
+
+	// if reorder_nodes() was called, node i of the interface is nodes[node_pos[i]]
+	// and nodes[k] is node node_order[k] of the interface; NULL otherwise
+	node_id				*node_pos, *node_order;
+
 	int					node_num;
+	bool				arcs_reordered;	// set by finalize(), see arcs_in_add_order()
+
+	// a part of another Graph (see the constructor below) shares its arrays
+	bool				is_part;
+	node_id				part_first;	// first node initialized by maxflow_init() (0 unless is_part)
 
-	DBlock<nodeptr>		*nodeptr_block;
+	Deque<node_ref>		*orphan_queue;	// created by the first call to maxflow()
 
 	void	(*error_function)(const char *);	// this function is called if a error occurs,
 										// with a corresponding error message
@@ -329,36 +675,79 @@ private:
 
 	// reusing trees & list of changed pixels
 	int					maxflow_iteration; // counter
+	algotype			algorithm; // see set_algorithm()
 	Block<node_id>		*changed_list;
 
+	// see set_checkpoint()
+	char				*checkpoint_file;
+	int					checkpoint_interval;
+
+#ifdef MAXFLOW_STATS
+	maxflow_stats		stats;
+#endif
+
 	/////////////////////////////////////////////////////////////////////////
 
-	node				*queue_first[2], *queue_last[2];	// list of active nodes
-	nodeptr				*orphan_first, *orphan_last;		// list of pointers to orphans
+	node_ref			queue_first[2], queue_last[2];		// list of active nodes
+	node_ref			*bucket_first, *bucket_last;		// GRAPH_DISTANCE: active nodes of each distance
+	int					bucket_num;							// size of bucket_first and bucket_last
+	int					bucket_min, bucket_max;				// the non-empty buckets are in this range
+	int					alternate;							// GRAPH_ALTERNATE: queue of the next active node
 	int					TIME;								// monotonically increasing global counter
 
 	/////////////////////////////////////////////////////////////////////////
 
+	typedef GraphTreeState<node, tree, links::split_trees> tree_state;
+
+	// N(i) and A(a) are the node and the arc a link refers to, T(i) is the tree state of N(i)
+	node& N(node_ref i) { return *links::node_ptr(nodes, i); }
+	typename tree_state::type& T(node_ref i) { return tree_state::get(nodes, trees, &N(i)); }
+	arc& A(arc_ref a) { return *links::arc_ptr(arcs, a); }
+	node_ref NREF(node* i) { return links::node_ref_of(nodes, i); }
+	arc_ref AREF(arc* a) { return links::arc_ref_of(arcs, a); }
+
+	node_id origin(arc* a) { return (node_id)(&N(A(a->sister).head) - nodes); } // node the arc a goes out of
+	node_id node_index(node_id i) { return (node_pos) ? node_pos[i] : i; } // position in nodes[] of node i of the interface
+	node_id node_name(node_id k) { return (node_order) ? node_order[k] : k; } // node of the interface at nodes[k]
+
 	void reallocate_nodes(int num); // num is the number of new nodes
 	void reallocate_arcs();
 
 	// functions for processing active list
-	void set_active(node *i);
-	node *next_active();
+	void set_active(node_ref i);
+	void reallocate_buckets(int d); // GRAPH_DISTANCE: room for the nodes of distance d
+	node_ref next_active();
+
+	// functions for processing orphans queue
+	void set_orphan_front(node_ref i); // add to the beginning of the queue
+	void set_orphan_rear(node_ref i);  // add to the end of the queue
 
-	// functions for processing orphans list
-	void set_orphan_front(node* i); // add to the beginning of the list
-	void set_orphan_rear(node* i);  // add to the end of the list
+	void add_to_changed_list(node_ref i);
 
-	void add_to_changed_list(node* i);
+	// files of save(), load() and checkpoints; read_graph_file() returns the node being grown (with_state)
+	void write_graph_file(const char* filename, bool with_state, node_ref current_node);
+	node_ref read_graph_file(const char* filename, bool with_state);
+	void write_checkpoint(node_ref current_node);
 
 	void maxflow_init();             // called if reuse_trees == false
 	void maxflow_reuse_trees_init(); // called if reuse_trees == true
-	void augment(arc *middle_arc);
-	void process_source_orphan(node *i);
-	void process_sink_orphan(node *i);
-
-	void test_consistency(node* current_node=NULL); // debug function
+	void pseudoflow();               // called if reuse_trees == false and algorithm == HPF (see pseudoflow.cpp)
+	template <class PF> void pseudoflow_recover(PF& P); // sends back the excess the t-links cannot hold
+	void ibfs();                     // called if reuse_trees == false and algorithm == IBFS (see ibfs.cpp)
+	template <class IB> void ibfs_augment(IB& I, int s, int t, arc_ref middle_arc);
+	flowtype maxflow_loop(node_ref current_node); // growth, augmentation and adoption until no path is left
+	void augment(arc_ref middle_arc);
+	void process_source_orphan(node_ref i);
+	void process_sink_orphan(node_ref i);
+
+	void test_consistency(node_ref current_node=0); // debug function
+
+	// A part of g: a Graph sharing the nodes and arcs of g, whose maxflow() (with BK, without
+	// reuse_trees) starts from nodes first .. last-1 of nodes[] only and counts the flow of
+	// their paths. If no residual arc joins these nodes to the others, parts that do not
+	// overlap can run maxflow() concurrently; ParallelGraph then joins their flows and times.
+	Graph(Graph* g, node_id first, node_id last);
+	template <typename, typename, typename, int> friend class ParallelGraph;
 };
 
 
@@ -377,14 +766,19 @@ private:
 
 
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline typename Graph<captype,tcaptype,flowtype>::node_id Graph<captype,tcaptype,flowtype>::add_node(int num)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline typename Graph<captype,tcaptype,flowtype,layout,schedule>::node_id Graph<captype,tcaptype,flowtype,layout,schedule>::add_node(int num)
 {
 	assert(num > 0);
 
 	if (node_last + num > node_max) reallocate_nodes(num);
 
 	memset(node_last, 0, num*sizeof(node));
+	if (tcaps) memset(tcaps + 2*node_num, 0, 2*num*sizeof(tcaptype));
+	if (node_pos)
+	{
+		for (node_id k=node_num; k<node_num+num; k++) node_pos[k] = node_order[k] = k;
+	}
 
 	node_id i = node_num;
 	node_num += num;
@@ -392,10 +786,17 @@ template <typename captype, typename tcaptype, typename flowtype>
 	return i;
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::add_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::add_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink)
 {
 	assert(i >= 0 && i < node_num);
+	i = node_index(i);
+
+	if (tcaps)
+	{
+		tcaps[2*i]   += cap_source;
+		tcaps[2*i+1] += cap_sink;
+	}
 
 	tcaptype delta = nodes[i].tr_cap;
 	if (delta > 0) cap_source += delta;
@@ -404,8 +805,8 @@ template <typename captype, typename tcaptype, typename flowtype>
 	nodes[i].tr_cap = cap_source - cap_sink;
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::add_edge(node_id _i, node_id _j, captype cap, captype rev_cap)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::add_edge(node_id _i, node_id _j, captype cap, captype rev_cap)
 {
 	assert(_i >= 0 && _i < node_num);
 	assert(_j >= 0 && _j < node_num);
@@ -418,76 +819,101 @@ template <typename captype, typename tcaptype, typename flowtype>
 	arc *a = arc_last ++;
 	arc *a_rev = arc_last ++;
 
-	node* i = nodes + _i;
-	node* j = nodes + _j;
+	node* i = nodes + node_index(_i);
+	node* j = nodes + node_index(_j);
 
-	a -> sister = a_rev;
-	a_rev -> sister = a;
+	a -> sister = AREF(a_rev);
+	a_rev -> sister = AREF(a);
 	a -> next = i -> first;
-	i -> first = a;
+	i -> first = AREF(a);
 	a_rev -> next = j -> first;
-	j -> first = a_rev;
-	a -> head = j;
-	a_rev -> head = i;
+	j -> first = AREF(a_rev);
+	a -> head = NREF(j);
+	a_rev -> head = NREF(i);
 	a -> r_cap = cap;
 	a_rev -> r_cap = rev_cap;
+
+	if (caps)
+	{
+		caps[a - arcs] = cap;
+		caps[a_rev - arcs] = rev_cap;
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::set_edge(arc* a, captype cap, captype rev_cap)
+{
+	assert(a >= arcs && a < arc_last);
+	assert(cap >= 0);
+	assert(rev_cap >= 0);
+
+	arc* a_rev = &A(a->sister);
+	a -> r_cap = cap;
+	a_rev -> r_cap = rev_cap;
+
+	if (caps)
+	{
+		caps[a - arcs] = cap;
+		caps[a_rev - arcs] = rev_cap;
+	}
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline typename Graph<captype,tcaptype,flowtype>::arc* Graph<captype,tcaptype,flowtype>::get_first_arc()
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline typename Graph<captype,tcaptype,flowtype,layout,schedule>::arc* Graph<captype,tcaptype,flowtype,layout,schedule>::get_first_arc()
 {
 	return arcs;
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline typename Graph<captype,tcaptype,flowtype>::arc* Graph<captype,tcaptype,flowtype>::get_next_arc(arc* a) 
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline typename Graph<captype,tcaptype,flowtype,layout,schedule>::arc* Graph<captype,tcaptype,flowtype,layout,schedule>::get_next_arc(arc* a) 
 {
 	return a + 1; 
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::get_arc_ends(arc* a, node_id& i, node_id& j)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::get_arc_ends(arc* a, node_id& i, node_id& j)
 {
 	assert(a >= arcs && a < arc_last);
-	i = (node_id) (a->sister->head - nodes);
-	j = (node_id) (a->head - nodes);
+	i = node_name((node_id) (&N(A(a->sister).head) - nodes));
+	j = node_name((node_id) (&N(a->head) - nodes));
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline tcaptype Graph<captype,tcaptype,flowtype>::get_trcap(node_id i)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline tcaptype Graph<captype,tcaptype,flowtype,layout,schedule>::get_trcap(node_id i)
 {
 	assert(i>=0 && i<node_num);
-	return nodes[i].tr_cap;
+	return nodes[node_index(i)].tr_cap;
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline captype Graph<captype,tcaptype,flowtype>::get_rcap(arc* a)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline captype Graph<captype,tcaptype,flowtype,layout,schedule>::get_rcap(arc* a)
 {
 	assert(a >= arcs && a < arc_last);
 	return a->r_cap;
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::set_trcap(node_id i, tcaptype trcap)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::set_trcap(node_id i, tcaptype trcap)
 {
 	assert(i>=0 && i<node_num); 
-	nodes[i].tr_cap = trcap;
+	nodes[node_index(i)].tr_cap = trcap;
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::set_rcap(arc* a, captype rcap)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::set_rcap(arc* a, captype rcap)
 {
 	assert(a >= arcs && a < arc_last);
 	a->r_cap = rcap;
 }
 
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline typename Graph<captype,tcaptype,flowtype>::termtype Graph<captype,tcaptype,flowtype>::what_segment(node_id i, termtype default_segm)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline typename Graph<captype,tcaptype,flowtype,layout,schedule>::termtype Graph<captype,tcaptype,flowtype,layout,schedule>::what_segment(node_id i, termtype default_segm)
 {
-	if (nodes[i].parent)
+	node_ref j = NREF(nodes + node_index(i));
+	if (T(j).parent)
 	{
-		return (nodes[i].is_sink) ? SINK : SOURCE;
+		return (T(j).is_sink) ? SINK : SOURCE;
 	}
 	else
 	{
@@ -495,19 +921,19 @@ template <typename captype, typename tcaptype, typename flowtype>
 	}
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::mark_node(node_id _i)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::mark_node(node_id _i)
 {
-	node* i = nodes + _i;
-	if (!i->next)
+	node_ref i = NREF(nodes + node_index(_i));
+	if (!N(i).next)
 	{
 		/* it's not in the list yet */
-		if (queue_last[1]) queue_last[1] -> next = i;
+		if (queue_last[1]) N(queue_last[1]).next = i;
 		else               queue_first[1]        = i;
 		queue_last[1] = i;
-		i -> next = i;
+		N(i).next = i;
 	}
-	i->is_marked = 1;
+	N(i).is_marked = 1;
 }
 
 
@@ -0,0 +1,725 @@
+/* gridgraph.cpp */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gridgraph.h"
+
+
+/*
+	special constants for node->parent.
+	A node whose parent is its neighbour in direction d has parent ARC+d.
+*/
+#define TERMINAL 1		/* to terminal */
+#define ORPHAN   2		/* orphan */
+#define ARC      3		/* to the neighbour in direction parent-ARC */
+
+
+#define INFINITE_D ((int)(((unsigned)-1)/2))		/* infinite distance to the terminal */
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	GridGraph<captype, tcaptype, flowtype>::GridGraph(int _width, int _height, void (*err_function)(const char *))
+	: width(_width),
+	  height(_height),
+	  node_num(0),
+	  orphan_queue(NULL),
+	  error_function(err_function)
+{
+	int x, y;
+	node* i;
+
+	if (width <= 0 || height <= 0) { if (error_function) (*error_function)("Empty grid!"); exit(1); }
+
+	shift[RIGHT] = 1;
+	shift[DOWN]  = width;
+	shift[LEFT]  = -1;
+	shift[UP]    = -width;
+
+	nodes = (node*) malloc(width*height*sizeof(node));
+	r_caps = (captype*) malloc(4*width*height*sizeof(captype));
+	if (!nodes || !r_caps) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	node_last = nodes + width*height;
+
+	memset(nodes, 0, width*height*sizeof(node));
+	memset(r_caps, 0, 4*width*height*sizeof(captype));
+	for (i=nodes, y=0; y<height; y++)
+	for (x=0; x<width; x++, i++)
+	{
+		if (x+1 < width)  i->neighbors |= 1<<RIGHT;
+		if (y+1 < height) i->neighbors |= 1<<DOWN;
+		if (x > 0)        i->neighbors |= 1<<LEFT;
+		if (y > 0)        i->neighbors |= 1<<UP;
+	}
+
+	maxflow_iteration = 0;
+	flow = 0;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	GridGraph<captype,tcaptype,flowtype>::~GridGraph()
+{
+	delete orphan_queue;
+	free(nodes);
+	free(r_caps);
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void GridGraph<captype,tcaptype,flowtype>::reset()
+{
+	node* i;
+
+	for (i=nodes; i<node_last; i++)
+	{
+		i -> next = NULL;
+		i -> parent = 0;
+		i -> is_marked = 0;
+		i -> is_in_changed_list = 0;
+		i -> tr_cap = 0;
+	}
+	memset(r_caps, 0, 4*width*height*sizeof(captype));
+	node_num = 0;
+
+	maxflow_iteration = 0;
+	flow = 0;
+}
+
+/***********************************************************************/
+
+/*
+	Functions for processing active list.
+	Same as in maxflow.cpp.
+*/
+
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::set_active(node *i)
+{
+	if (!i->next)
+	{
+		/* it's not in the list yet */
+		if (queue_last[1]) queue_last[1] -> next = i;
+		else               queue_first[1]        = i;
+		queue_last[1] = i;
+		i -> next = i;
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline typename GridGraph<captype,tcaptype,flowtype>::node* GridGraph<captype,tcaptype,flowtype>::next_active()
+{
+	node *i;
+
+	while ( 1 )
+	{
+		if (!(i=queue_first[0]))
+		{
+			queue_first[0] = i = queue_first[1];
+			queue_last[0]  = queue_last[1];
+			queue_first[1] = NULL;
+			queue_last[1]  = NULL;
+			if (!i) return NULL;
+		}
+
+		/* remove it from the active list */
+		if (i->next == i) queue_first[0] = queue_last[0] = NULL;
+		else              queue_first[0] = i -> next;
+		i -> next = NULL;
+
+		/* a node in the list is active iff it has a parent */
+		if (i->parent) return i;
+	}
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::set_orphan_front(node *i)
+{
+	i -> parent = ORPHAN;
+	orphan_queue -> PushFront(i);
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::set_orphan_rear(node *i)
+{
+	i -> parent = ORPHAN;
+	orphan_queue -> PushBack(i);
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::add_to_changed_list(node *i)
+{
+	if (changed_list && !i->is_in_changed_list)
+	{
+		node_id* ptr = changed_list->New();
+		*ptr = (node_id)(i - nodes);
+		i->is_in_changed_list = true;
+	}
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void GridGraph<captype,tcaptype,flowtype>::maxflow_init()
+{
+	node *i;
+
+	queue_first[0] = queue_last[0] = NULL;
+	queue_first[1] = queue_last[1] = NULL;
+	orphan_queue -> Reset();
+
+	TIME = 0;
+
+	for (i=nodes; i<nodes+node_num; i++)
+	{
+		i -> next = NULL;
+		i -> is_marked = 0;
+		i -> is_in_changed_list = 0;
+		i -> TS = TIME;
+		if (i->tr_cap > 0)
+		{
+			/* i is connected to the source */
+			i -> is_sink = 0;
+			i -> parent = TERMINAL;
+			set_active(i);
+			i -> DIST = 1;
+		}
+		else if (i->tr_cap < 0)
+		{
+			/* i is connected to the sink */
+			i -> is_sink = 1;
+			i -> parent = TERMINAL;
+			set_active(i);
+			i -> DIST = 1;
+		}
+		else
+		{
+			i -> parent = 0;
+		}
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void GridGraph<captype,tcaptype,flowtype>::maxflow_reuse_trees_init()
+{
+	node* i;
+	node* j;
+	node* queue = queue_first[1];
+	int d;
+
+	queue_first[0] = queue_last[0] = NULL;
+	queue_first[1] = queue_last[1] = NULL;
+	orphan_queue -> Reset();
+
+	TIME ++;
+
+	while ((i=queue))
+	{
+		queue = i->next;
+		if (queue == i) queue = NULL;
+		i->next = NULL;
+		i->is_marked = 0;
+		set_active(i);
+
+		if (i->tr_cap == 0)
+		{
+			if (i->parent) set_orphan_rear(i);
+			continue;
+		}
+
+		if (i->tr_cap > 0)
+		{
+			if (!i->parent || i->is_sink)
+			{
+				i->is_sink = 0;
+				for (d=0; d<4; d++)
+				if (i->neighbors & (1<<d))
+				{
+					j = head(i, d);
+					if (!j->is_marked)
+					{
+						if (j->parent == ARC+(d^2)) set_orphan_rear(j);
+						if (j->parent && j->is_sink && r_cap(i, d) > 0) set_active(j);
+					}
+				}
+				add_to_changed_list(i);
+			}
+		}
+		else
+		{
+			if (!i->parent || !i->is_sink)
+			{
+				i->is_sink = 1;
+				for (d=0; d<4; d++)
+				if (i->neighbors & (1<<d))
+				{
+					j = head(i, d);
+					if (!j->is_marked)
+					{
+						if (j->parent == ARC+(d^2)) set_orphan_rear(j);
+						if (j->parent && !j->is_sink && r_cap(j, d^2) > 0) set_active(j);
+					}
+				}
+				add_to_changed_list(i);
+			}
+		}
+		i->parent = TERMINAL;
+		i -> TS = TIME;
+		i -> DIST = 1;
+	}
+
+	//test_consistency();
+
+	/* adoption */
+	while (!orphan_queue -> IsEmpty())
+	{
+		i = orphan_queue -> PopFront();
+		if (i->is_sink) process_sink_orphan(i);
+		else            process_source_orphan(i);
+	}
+	/* adoption end */
+
+	//test_consistency();
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void GridGraph<captype,tcaptype,flowtype>::augment(node *middle, int middle_d)
+{
+	node *i, *j;
+	int d;
+	tcaptype bottleneck;
+
+
+	/* 1. Finding bottleneck capacity */
+	/* 1a - the source tree */
+	bottleneck = r_cap(middle, middle_d);
+	for (i=middle; ; i=j)
+	{
+		if (i->parent == TERMINAL) break;
+		d = i->parent - ARC;
+		j = head(i, d);
+		if (bottleneck > r_cap(j, d^2)) bottleneck = r_cap(j, d^2);
+	}
+	if (bottleneck > i->tr_cap) bottleneck = i -> tr_cap;
+	/* 1b - the sink tree */
+	for (i=head(middle, middle_d); ; i=j)
+	{
+		if (i->parent == TERMINAL) break;
+		d = i->parent - ARC;
+		j = head(i, d);
+		if (bottleneck > r_cap(i, d)) bottleneck = r_cap(i, d);
+	}
+	if (bottleneck > - i->tr_cap) bottleneck = - i -> tr_cap;
+
+
+	/* 2. Augmenting */
+	/* 2a - the source tree */
+	r_cap(head(middle, middle_d), middle_d^2) += bottleneck;
+	r_cap(middle, middle_d) -= bottleneck;
+	for (i=middle; ; i=j)
+	{
+		if (i->parent == TERMINAL) break;
+		d = i->parent - ARC;
+		j = head(i, d);
+		r_cap(i, d) += bottleneck;
+		r_cap(j, d^2) -= bottleneck;
+		if (!r_cap(j, d^2))
+		{
+			set_orphan_front(i); // add i to the beginning of the adoption list
+		}
+	}
+	i -> tr_cap -= bottleneck;
+	if (!i->tr_cap)
+	{
+		set_orphan_front(i); // add i to the beginning of the adoption list
+	}
+	/* 2b - the sink tree */
+	for (i=head(middle, middle_d); ; i=j)
+	{
+		if (i->parent == TERMINAL) break;
+		d = i->parent - ARC;
+		j = head(i, d);
+		r_cap(j, d^2) += bottleneck;
+		r_cap(i, d) -= bottleneck;
+		if (!r_cap(i, d))
+		{
+			set_orphan_front(i); // add i to the beginning of the adoption list
+		}
+	}
+	i -> tr_cap += bottleneck;
+	if (!i->tr_cap)
+	{
+		set_orphan_front(i); // add i to the beginning of the adoption list
+	}
+
+
+	flow += bottleneck;
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void GridGraph<captype,tcaptype,flowtype>::process_source_orphan(node *i)
+{
+	node *j;
+	int d0, d0_min = -1, a;
+	int d, d_min = INFINITE_D;
+
+	/* trying to find a new parent */
+	for (d0=0; d0<4; d0++)
+	if ((i->neighbors & (1<<d0)) && r_cap(head(i, d0), d0^2))
+	{
+		j = head(i, d0);
+		if (!j->is_sink && (a=j->parent))
+		{
+			/* checking the origin of j */
+			d = 0;
+			while ( 1 )
+			{
+				if (j->TS == TIME)
+				{
+					d += j -> DIST;
+					break;
+				}
+				a = j -> parent;
+				d ++;
+				if (a==TERMINAL)
+				{
+					j -> TS = TIME;
+					j -> DIST = 1;
+					break;
+				}
+				if (a==ORPHAN) { d = INFINITE_D; break; }
+				j = head(j, a-ARC);
+			}
+			if (d<INFINITE_D) /* j originates from the source - done */
+			{
+				if (d<d_min)
+				{
+					d0_min = d0;
+					d_min = d;
+				}
+				/* set marks along the path */
+				for (j=head(i, d0); j->TS!=TIME; j=head(j, j->parent-ARC))
+				{
+					j -> TS = TIME;
+					j -> DIST = d --;
+				}
+			}
+		}
+	}
+
+	if (d0_min >= 0)
+	{
+		i -> parent = ARC + d0_min;
+		i -> TS = TIME;
+		i -> DIST = d_min + 1;
+	}
+	else
+	{
+		/* no parent is found */
+		i -> parent = 0;
+		add_to_changed_list(i);
+
+		/* process neighbors */
+		for (d0=0; d0<4; d0++)
+		if (i->neighbors & (1<<d0))
+		{
+			j = head(i, d0);
+			if (!j->is_sink && (a=j->parent))
+			{
+				if (r_cap(j, d0^2)) set_active(j);
+				if (a == ARC+(d0^2))
+				{
+					set_orphan_rear(j); // add j to the end of the adoption list
+				}
+			}
+		}
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void GridGraph<captype,tcaptype,flowtype>::process_sink_orphan(node *i)
+{
+	node *j;
+	int d0, d0_min = -1, a;
+	int d, d_min = INFINITE_D;
+
+	/* trying to find a new parent */
+	for (d0=0; d0<4; d0++)
+	if ((i->neighbors & (1<<d0)) && r_cap(i, d0))
+	{
+		j = head(i, d0);
+		if (j->is_sink && (a=j->parent))
+		{
+			/* checking the origin of j */
+			d = 0;
+			while ( 1 )
+			{
+				if (j->TS == TIME)
+				{
+					d += j -> DIST;
+					break;
+				}
+				a = j -> parent;
+				d ++;
+				if (a==TERMINAL)
+				{
+					j -> TS = TIME;
+					j -> DIST = 1;
+					break;
+				}
+				if (a==ORPHAN) { d = INFINITE_D; break; }
+				j = head(j, a-ARC);
+			}
+			if (d<INFINITE_D) /* j originates from the sink - done */
+			{
+				if (d<d_min)
+				{
+					d0_min = d0;
+					d_min = d;
+				}
+				/* set marks along the path */
+				for (j=head(i, d0); j->TS!=TIME; j=head(j, j->parent-ARC))
+				{
+					j -> TS = TIME;
+					j -> DIST = d --;
+				}
+			}
+		}
+	}
+
+	if (d0_min >= 0)
+	{
+		i -> parent = ARC + d0_min;
+		i -> TS = TIME;
+		i -> DIST = d_min + 1;
+	}
+	else
+	{
+		/* no parent is found */
+		i -> parent = 0;
+		add_to_changed_list(i);
+
+		/* process neighbors */
+		for (d0=0; d0<4; d0++)
+		if (i->neighbors & (1<<d0))
+		{
+			j = head(i, d0);
+			if (j->is_sink && (a=j->parent))
+			{
+				if (r_cap(i, d0)) set_active(j);
+				if (a == ARC+(d0^2))
+				{
+					set_orphan_rear(j); // add j to the end of the adoption list
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	flowtype GridGraph<captype,tcaptype,flowtype>::maxflow(bool reuse_trees, Block<node_id>* _changed_list)
+{
+	node *i, *j, *current_node = NULL;
+	node *middle; /* the middle arc goes from 'middle' in direction middle_d */
+	int d, middle_d = 0;
+
+	if (!orphan_queue) orphan_queue = new Deque<node*>(ORPHAN_QUEUE_SIZE, error_function);
+
+	changed_list = _changed_list;
+	if (maxflow_iteration == 0 && reuse_trees) { if (error_function) (*error_function)("reuse_trees cannot be used in the first call to maxflow()!"); exit(1); }
+	if (changed_list && !reuse_trees) { if (error_function) (*error_function)("changed_list cannot be used without reuse_trees!"); exit(1); }
+
+	if (reuse_trees) maxflow_reuse_trees_init();
+	else             maxflow_init();
+
+	// main loop
+	while ( 1 )
+	{
+		// test_consistency(current_node);
+
+		if ((i=current_node))
+		{
+			i -> next = NULL; /* remove active flag */
+			if (!i->parent) i = NULL;
+		}
+		if (!i)
+		{
+			if (!(i = next_active())) break;
+		}
+
+		/* growth */
+		middle = NULL;
+		if (!i->is_sink)
+		{
+			/* grow source tree */
+			for (d=0; d<4; d++)
+			if ((i->neighbors & (1<<d)) && r_cap(i, d))
+			{
+				j = head(i, d);
+				if (!j->parent)
+				{
+					j -> is_sink = 0;
+					j -> parent = ARC + (d^2);
+					j -> TS = i -> TS;
+					j -> DIST = i -> DIST + 1;
+					set_active(j);
+					add_to_changed_list(j);
+				}
+				else if (j->is_sink) { middle = i; middle_d = d; break; }
+				else if (j->TS <= i->TS &&
+				         j->DIST > i->DIST)
+				{
+					/* heuristic - trying to make the distance from j to the source shorter */
+					j -> parent = ARC + (d^2);
+					j -> TS = i -> TS;
+					j -> DIST = i -> DIST + 1;
+				}
+			}
+		}
+		else
+		{
+			/* grow sink tree */
+			for (d=0; d<4; d++)
+			if ((i->neighbors & (1<<d)) && r_cap(head(i, d), d^2))
+			{
+				j = head(i, d);
+				if (!j->parent)
+				{
+					j -> is_sink = 1;
+					j -> parent = ARC + (d^2);
+					j -> TS = i -> TS;
+					j -> DIST = i -> DIST + 1;
+					set_active(j);
+					add_to_changed_list(j);
+				}
+				else if (!j->is_sink) { middle = j; middle_d = d^2; break; }
+				else if (j->TS <= i->TS &&
+				         j->DIST > i->DIST)
+				{
+					/* heuristic - trying to make the distance from j to the sink shorter */
+					j -> parent = ARC + (d^2);
+					j -> TS = i -> TS;
+					j -> DIST = i -> DIST + 1;
+				}
+			}
+		}
+
+		TIME ++;
+
+		if (middle)
+		{
+			i -> next = i; /* set active flag */
+			current_node = i;
+
+			/* augmentation */
+			augment(middle, middle_d);
+			/* augmentation end */
+
+			/* adoption */
+			while (!orphan_queue -> IsEmpty())
+			{
+				i = orphan_queue -> PopFront();
+				if (i->is_sink) process_sink_orphan(i);
+				else            process_source_orphan(i);
+			}
+			/* adoption end */
+		}
+		else current_node = NULL;
+	}
+	// test_consistency();
+
+	maxflow_iteration ++;
+	return flow;
+}
+
+/***********************************************************************/
+
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void GridGraph<captype,tcaptype,flowtype>::test_consistency(node* current_node)
+{
+	node *i;
+	int d, r;
+	int num1 = 0, num2 = 0;
+
+	// test whether all nodes i with i->next!=NULL are indeed in the queue
+	for (i=nodes; i<nodes+node_num; i++)
+	{
+		if (i->next || i==current_node) num1 ++;
+	}
+	for (r=0; r<3; r++)
+	{
+		i = (r == 2) ? current_node : queue_first[r];
+		if (i)
+		for ( ; ; i=i->next)
+		{
+			num2 ++;
+			if (i->next == i)
+			{
+				if (r<2) assert(i == queue_last[r]);
+				else     assert(i == current_node);
+				break;
+			}
+		}
+	}
+	assert(num1 == num2);
+
+	for (i=nodes; i<nodes+node_num; i++)
+	{
+		// test whether all edges in seach trees are non-saturated
+		if (i->parent == 0) {}
+		else if (i->parent == ORPHAN) {}
+		else if (i->parent == TERMINAL)
+		{
+			if (!i->is_sink) assert(i->tr_cap > 0);
+			else             assert(i->tr_cap < 0);
+		}
+		else
+		{
+			d = i->parent - ARC;
+			if (!i->is_sink) assert (r_cap(head(i, d), d^2) > 0);
+			else             assert (r_cap(i, d) > 0);
+		}
+		// test whether passive nodes in search trees have neighbors in
+		// a different tree through non-saturated edges
+		if (i->parent && !i->next)
+		{
+			if (!i->is_sink)
+			{
+				assert(i->tr_cap >= 0);
+				for (d=0; d<4; d++)
+				if (i->neighbors & (1<<d))
+				{
+					if (r_cap(i, d) > 0) assert(head(i, d)->parent && !head(i, d)->is_sink);
+				}
+			}
+			else
+			{
+				assert(i->tr_cap <= 0);
+				for (d=0; d<4; d++)
+				if (i->neighbors & (1<<d))
+				{
+					if (r_cap(head(i, d), d^2) > 0) assert(head(i, d)->parent && head(i, d)->is_sink);
+				}
+			}
+		}
+		// test marking invariants
+		if (i->parent && i->parent!=ORPHAN && i->parent!=TERMINAL)
+		{
+			d = i->parent - ARC;
+			assert(i->TS <= head(i, d)->TS);
+			if (i->TS == head(i, d)->TS) assert(i->DIST > head(i, d)->DIST);
+		}
+	}
+}
+
+#include "instances.inc"
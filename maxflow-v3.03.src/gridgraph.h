@@ -0,0 +1,336 @@
+/* gridgraph.h */
+/*
+	GridGraph is the maxflow algorithm of graph.h specialized to
+	4-connected grids, such as the pixel lattice of an image.
+
+	Graph stores every arc with explicit 'head', 'next' and 'sister' pointers.
+	On a grid this topology is implied by the width, so GridGraph stores
+	only the residual capacities of the four arcs leaving each node.
+	The head of an arc and its reverse arc are computed from fixed offsets:
+	the arc of node i in direction d goes to i+shift[d], and its sister is
+	the arc of that node in the opposite direction d^2.
+
+	The interface is the one of Graph (add_tweights(), add_edge(), maxflow(),
+	what_segment(), reusing trees), except that the nodes and the possible
+	edges are fixed by the grid size given to the constructor.
+*/
+
+#ifndef __GRIDGRAPH_H__
+#define __GRIDGRAPH_H__
+
+#include <stdlib.h>
+#include <string.h>
+#include "block.h"
+
+#include <assert.h>
+// NOTE: in UNIX you need to use -DNDEBUG preprocessor option to supress assert's!!!
+
+
+
+// captype: type of edge capacities (excluding t-links)
+// tcaptype: type of t-links (edges between nodes and terminals)
+// flowtype: type of total flow
+//
+// Current instantiations are in instances.inc
+template <typename captype, typename tcaptype, typename flowtype> class GridGraph
+{
+public:
+	typedef enum
+	{
+		SOURCE	= 0,
+		SINK	= 1
+	} termtype; // terminals
+	typedef int node_id;
+
+	// Directions of the arcs leaving a node. The reverse of direction d is d^2.
+	typedef enum
+	{
+		RIGHT	= 0,
+		DOWN	= 1,
+		LEFT	= 2,
+		UP		= 3
+	} direction;
+
+	/////////////////////////////////////////////////////////////////////////
+	//                     BASIC INTERFACE FUNCTIONS                       //
+	/////////////////////////////////////////////////////////////////////////
+
+	// Constructor.
+	// Allocates a width x height grid. Node (x,y) has node_id y*width+x, and it
+	// is connected to the nodes (x+1,y), (x,y+1), (x-1,y) and (x,y-1) when they exist.
+	// All capacities are initially zero.
+	// The last (optional) argument is the pointer to the function which will be called
+	// if an error occurs; an error message is passed to this function.
+	// If this argument is omitted, exit(1) will be called.
+	GridGraph(int width, int height, void (*err_function)(const char *) = NULL);
+
+	// Destructor
+	~GridGraph();
+
+	// The nodes of the grid exist from the start; add_node() only hands out
+	// their ids in order (first call returns 0, and so on), so that code written
+	// for Graph can be used unchanged. At most width*height nodes can be added.
+	node_id add_node(int num = 1);
+
+	// Adds a bidirectional edge between 'i' and 'j' with the weights 'cap' and 'rev_cap'.
+	// 'i' and 'j' must be 4-connected in the grid. If called several times for the
+	// same pair, the weights are summed.
+	void add_edge(node_id i, node_id j, captype cap, captype rev_cap);
+
+	// Adds new edges 'SOURCE->i' and 'i->SINK' with corresponding weights.
+	// Can be called multiple times for each node.
+	// Weights can be negative.
+	void add_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink);
+
+	// Computes the maxflow. Can be called several times.
+	// reuse_trees and changed_list have the same meaning as in Graph.
+	flowtype maxflow(bool reuse_trees = false, Block<node_id>* changed_list = NULL);
+
+	// After the maxflow is computed, this function returns to which
+	// segment the node 'i' belongs (GridGraph<captype,tcaptype,flowtype>::SOURCE or GridGraph<captype,tcaptype,flowtype>::SINK).
+	//
+	// Occasionally there may be several minimum cuts. If a node can be assigned
+	// to both the source and the sink, then default_segm is returned.
+	termtype what_segment(node_id i, termtype default_segm = SOURCE);
+
+
+
+	//////////////////////////////////////////////
+	//       ADVANCED INTERFACE FUNCTIONS       //
+	//////////////////////////////////////////////
+
+	// Sets all capacities to zero. After that add_node(), add_edge() and
+	// add_tweights() must be called again. No memory is reallocated.
+	void reset();
+
+	int get_width() { return width; }
+	int get_height() { return height; }
+	int get_node_num() { return node_num; }
+	// bytes allocated per node of the grid (node record and the capacities of its arcs)
+	static size_t get_node_size() { return sizeof(node) + 4*sizeof(captype); }
+
+	// returns residual capacity of SOURCE->i minus residual capacity of i->SINK
+	tcaptype get_trcap(node_id i);
+	// returns residual capacity of the arc leaving 'i' in direction 'd'
+	captype get_rcap(node_id i, direction d);
+
+	// NOTE: If these functions are used, the value of the flow
+	// returned by maxflow() will not be valid!
+	void set_trcap(node_id i, tcaptype trcap);
+	void set_rcap(node_id i, direction d, captype rcap);
+
+	// Same as in Graph:
+	//   add_tweights(i),set_trcap(i)    => call mark_node(i)
+	//   add_edge(i,j),set_rcap(i,d)     => call mark_node(i); mark_node(j)
+	void mark_node(node_id i);
+
+	void remove_from_changed_list(node_id i)
+	{
+		assert(i>=0 && i<node_num && nodes[i].is_in_changed_list);
+		nodes[i].is_in_changed_list = 0;
+	}
+
+
+
+
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+private:
+	// internal variables and functions
+
+	struct node
+	{
+		node			*next;		// pointer to the next active node
+									//   (or to itself if it is the last node in the list)
+		int				TS;			// timestamp showing when DIST was computed
+		int				DIST;		// distance to the terminal
+
+		unsigned char	parent;		// node's parent: 0 if none, TERMINAL, ORPHAN,
+									// or ARC+d if the parent is the neighbour in direction d
+		unsigned char	neighbors;	// bit d is set if the node has a neighbour in direction d
+		unsigned char	is_sink : 1;	// flag showing whether the node is in the source or in the sink tree (if parent!=0)
+		unsigned char	is_marked : 1;	// set by mark_node()
+		unsigned char	is_in_changed_list : 1; // set by maxflow if
+
+		tcaptype		tr_cap;		// if tr_cap > 0 then tr_cap is residual capacity of the arc SOURCE->node
+									// otherwise         -tr_cap is residual capacity of the arc node->SINK
+	};
+
+	static const int ORPHAN_QUEUE_SIZE = 128; // initial size of the orphan queue
+
+	int					width, height;
+	int					shift[4];	// node i is connected to node i+shift[d] in direction d
+
+	node				*nodes, *node_last; // node_last = nodes+width*height
+	captype				*r_caps;	// r_caps[4*i+d] is residual capacity of the arc leaving i in direction d
+
+	int					node_num;
+
+	Deque<node*>		*orphan_queue;	// created by the first call to maxflow()
+
+	void	(*error_function)(const char *);	// this function is called if a error occurs,
+										// with a corresponding error message
+										// (or exit(1) is called if it's NULL)
+
+	flowtype			flow;		// total flow
+
+	// reusing trees & list of changed pixels
+	int					maxflow_iteration; // counter
+	Block<node_id>		*changed_list;
+
+	/////////////////////////////////////////////////////////////////////////
+
+	node				*queue_first[2], *queue_last[2];	// list of active nodes
+	int					TIME;								// monotonically increasing global counter
+
+	/////////////////////////////////////////////////////////////////////////
+
+	// the neighbour of i in direction d, and the residual capacity of the arc to it
+	node *head(node *i, int d) { return i + shift[d]; }
+	captype &r_cap(node *i, int d) { return r_caps[4*(i - nodes) + d]; }
+
+	// functions for processing active list
+	void set_active(node *i);
+	node *next_active();
+
+	// functions for processing orphans list
+	void set_orphan_front(node* i); // add to the beginning of the list
+	void set_orphan_rear(node* i);  // add to the end of the list
+
+	void add_to_changed_list(node* i);
+
+	void maxflow_init();             // called if reuse_trees == false
+	void maxflow_reuse_trees_init(); // called if reuse_trees == true
+	void augment(node *middle, int d); // middle arc goes from 'middle' in direction d
+	void process_source_orphan(node *i);
+	void process_sink_orphan(node *i);
+
+	void test_consistency(node* current_node=NULL); // debug function
+};
+
+
+
+
+
+
+
+
+
+
+
+///////////////////////////////////////
+// Implementation - inline functions //
+///////////////////////////////////////
+
+
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline typename GridGraph<captype,tcaptype,flowtype>::node_id GridGraph<captype,tcaptype,flowtype>::add_node(int num)
+{
+	assert(num > 0);
+
+	if (nodes + node_num + num > node_last) { if (error_function) (*error_function)("Too many nodes for the grid!"); exit(1); }
+
+	node_id i = node_num;
+	node_num += num;
+	return i;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::add_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink)
+{
+	assert(i >= 0 && i < node_num);
+
+	tcaptype delta = nodes[i].tr_cap;
+	if (delta > 0) cap_source += delta;
+	else           cap_sink   -= delta;
+	flow += (cap_source < cap_sink) ? cap_source : cap_sink;
+	nodes[i].tr_cap = cap_source - cap_sink;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::add_edge(node_id _i, node_id _j, captype cap, captype rev_cap)
+{
+	assert(_i >= 0 && _i < node_num);
+	assert(_j >= 0 && _j < node_num);
+	assert(cap >= 0);
+	assert(rev_cap >= 0);
+
+	node* i = nodes + _i;
+	int d;
+
+	// (if width is 1, RIGHT and DOWN have the same shift; the neighbour bits tell them apart)
+	for (d=0; d<4; d++)
+	{
+		if (_j - _i == shift[d] && (i->neighbors & (1<<d))) break;
+	}
+	if (d == 4) { if (error_function) (*error_function)("Edge between nodes that are not 4-connected!"); exit(1); }
+
+	r_cap(i, d) += cap;
+	r_cap(head(i, d), d^2) += rev_cap;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline tcaptype GridGraph<captype,tcaptype,flowtype>::get_trcap(node_id i)
+{
+	assert(i>=0 && i<node_num);
+	return nodes[i].tr_cap;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline captype GridGraph<captype,tcaptype,flowtype>::get_rcap(node_id i, direction d)
+{
+	assert(i>=0 && i<node_num);
+	return r_cap(nodes + i, d);
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::set_trcap(node_id i, tcaptype trcap)
+{
+	assert(i>=0 && i<node_num);
+	nodes[i].tr_cap = trcap;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::set_rcap(node_id i, direction d, captype rcap)
+{
+	assert(i>=0 && i<node_num);
+	assert(nodes[i].neighbors & (1<<d));
+	r_cap(nodes + i, d) = rcap;
+}
+
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline typename GridGraph<captype,tcaptype,flowtype>::termtype GridGraph<captype,tcaptype,flowtype>::what_segment(node_id i, termtype default_segm)
+{
+	if (nodes[i].parent)
+	{
+		return (nodes[i].is_sink) ? SINK : SOURCE;
+	}
+	else
+	{
+		return default_segm;
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline void GridGraph<captype,tcaptype,flowtype>::mark_node(node_id _i)
+{
+	node* i = nodes + _i;
+	if (!i->next)
+	{
+		/* it's not in the list yet */
+		if (queue_last[1]) queue_last[1] -> next = i;
+		else               queue_first[1]        = i;
+		queue_last[1] = i;
+		i -> next = i;
+	}
+	i->is_marked = 1;
+}
+
+
+#endif
@@ -0,0 +1,321 @@
+/* ibfs.cpp */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "graph.h"
+
+/*
+	special constant for Ibfs::node::parent (0 is an orphan)
+*/
+#define TERMINAL ( (arc_ref) 1 )		/* to terminal */
+
+/*
+	Incremental breadth-first search algorithm of Goldberg, Hed, Kaplan, Tarjan
+	and Werneck ("Maximum flows by incremental breadth-first search", ESA 2011).
+
+	Like the algorithm of maxflow.cpp it grows a source tree and a sink tree
+	and augments along the paths found between them, but the trees are kept
+	breadth-first: the label of a node is its exact distance to the terminal of
+	its tree, and a pass grows one tree by one level. After an augmentation an
+	orphan of label d looks for a new parent of label d-1 only; if there is
+	none, its label is increased by one (its children become orphans) and it is
+	processed again with the label after the lowest of its possible parents,
+	orphans being processed by increasing label. A node whose label would go
+	past the frontier of its tree leaves the tree, and the nodes of the tree
+	that could reach it scan their arcs again.
+
+	Only the IBFS variant is implemented, not the one with excesses (EIBFS).
+
+	It works on the residual capacities of the graph (tr_cap, r_cap) and on the
+	flow, so the result is a maximum flow in the representation of maxflow(),
+	which then builds its own search trees on it.
+*/
+
+template <typename arc_ref> class Ibfs
+{
+public:
+	enum { FREE = 0, SOURCE_TREE = 1, SINK_TREE = 2 };
+
+	struct node
+	{
+		int			tree;		// FREE, SOURCE_TREE or SINK_TREE
+		int			label;		// distance to the terminal of the tree
+		arc_ref		parent;		// arc to the parent, TERMINAL, or 0 for an orphan
+		arc_ref		current;	// next arc to be scanned for a new parent
+		int			next_orphan;
+	};
+
+	// nodes to be scanned, in the order they are pushed
+	struct queue
+	{
+		int			*items;
+		int			first, last, size;
+
+		bool empty() { return first == last; }
+		int count() { return last - first; }
+		int pop() { return items[first ++]; }
+		bool push(int k)
+		{
+			if (last == size)
+			{
+				int *p = (int*) realloc(items, 2*size*sizeof(int));
+				if (!p) return false;
+				items = p;
+				size *= 2;
+			}
+			items[last ++] = k;
+			return true;
+		}
+	};
+
+	Ibfs(int node_num) : n(node_num)
+	{
+		int t;
+		nodes = (node*) malloc(n*sizeof(node));
+		for (t=0; t<3; t++)
+		{
+			orphans[t] = (int*) malloc((n+2)*sizeof(int));
+			if (orphans[t]) for (int d=0; d<n+2; d++) orphans[t][d] = -1;
+			q[t].size = nq[t].size = 64;
+			q[t].first = q[t].last = nq[t].first = nq[t].last = 0;
+			q[t].items = (int*) malloc(q[t].size*sizeof(int));
+			nq[t].items = (int*) malloc(nq[t].size*sizeof(int));
+			D[t] = 1;
+			orphan_min[t] = n + 2;
+			orphan_max[t] = 0;
+		}
+	}
+
+	~Ibfs()
+	{
+		free(nodes);
+		for (int t=0; t<3; t++)
+		{
+			free(orphans[t]);
+			free(q[t].items);
+			free(nq[t].items);
+		}
+	}
+
+	bool allocated()
+	{
+		for (int t=1; t<3; t++) if (!orphans[t] || !q[t].items || !nq[t].items) return false;
+		return nodes != NULL;
+	}
+
+	int			n;
+	node		*nodes;
+	int			*orphans[3];	// orphans[t][d]: first orphan of label d of tree t
+	int			orphan_min[3], orphan_max[3]; // labels of the orphans of tree t are in this range
+	queue		q[3], nq[3];	// nodes of tree t to be scanned in this pass (resp. the next one)
+	int			D[3];			// labels up to D[t] are scanned by the current pass of tree t
+	int			growing;		// tree of the current pass
+	bool		out_of_memory;
+
+	// label above which a node of tree t leaves the tree
+	int max_label(int t) { return (t == growing) ? D[t] + 1 : D[t]; }
+
+	void push(int k)
+	{
+		int t = nodes[k].tree;
+		if (!((nodes[k].label <= D[t]) ? q[t].push(k) : nq[t].push(k))) out_of_memory = true;
+	}
+
+	void set_orphan(int k)
+	{
+		node* i = &nodes[k];
+		i->parent = 0;
+		i->next_orphan = orphans[i->tree][i->label];
+		orphans[i->tree][i->label] = k;
+		if (orphan_min[i->tree] > i->label) orphan_min[i->tree] = i->label;
+		if (orphan_max[i->tree] < i->label) orphan_max[i->tree] = i->label;
+	}
+};
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule>
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::ibfs()
+{
+	typedef Ibfs<arc_ref> IB;
+	IB I(node_num);
+	typename IB::node *v, *u;
+	int k, t, L;
+	arc_ref a;
+
+	if (!I.allocated()) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	I.out_of_memory = false;
+	I.growing = IB::SOURCE_TREE;
+
+	for (k=0; k<node_num; k++)
+	{
+		v = &I.nodes[k];
+		v->label = 1;
+		v->parent = TERMINAL;
+		v->current = nodes[k].first;
+		if      (nodes[k].tr_cap > 0) v->tree = IB::SOURCE_TREE;
+		else if (nodes[k].tr_cap < 0) v->tree = IB::SINK_TREE;
+		else  { v->tree = IB::FREE; v->parent = 0; continue; }
+		I.push(k);
+	}
+
+	for (t=IB::SOURCE_TREE; ; t=IB::SOURCE_TREE+IB::SINK_TREE-t)
+	{
+		/* a pass: grow tree t by one level (the trees take turns) */
+		I.growing = t;
+
+		while (!I.q[t].empty())
+		{
+			k = I.q[t].pop();
+			v = &I.nodes[k];
+			L = v->label;
+			if (v->tree != t || !v->parent || L > I.D[t]) continue;
+
+			for (a=nodes[k].first; a; )
+			{
+				if (v->tree != t || v->label != L) break; // k was moved by an augmentation
+				if (!((t == IB::SOURCE_TREE) ? A(a).r_cap : A(A(a).sister).r_cap)) { a = A(a).next; continue; }
+				int w = (int)(&N(A(a).head) - nodes);
+				u = &I.nodes[w];
+				if (u->tree == IB::FREE)
+				{
+					u->tree = t;
+					u->label = L + 1;
+					u->parent = A(a).sister;
+					u->current = nodes[w].first;
+					I.push(w);
+				}
+				else if (u->tree != t)
+				{
+					/* the arc a is scanned again after the augmentation */
+					if (t == IB::SOURCE_TREE) ibfs_augment(I, k, w, a);
+					else                      ibfs_augment(I, w, k, A(a).sister);
+					continue;
+				}
+				a = A(a).next;
+			}
+			if (I.out_of_memory) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+		}
+
+		/* the next level becomes the frontier; if it is empty, the tree
+		   cannot grow any more and the flow is maximum */
+		I.D[t] ++;
+		typename IB::queue tmp = I.q[t]; I.q[t] = I.nq[t]; I.nq[t] = tmp;
+		I.nq[t].first = I.nq[t].last = 0;
+		if (I.q[t].empty()) break;
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule>
+	template <class IB> void Graph<captype,tcaptype,flowtype,layout,schedule>::ibfs_augment(IB& I, int s, int t, arc_ref middle_arc)
+{
+	int k, i, d, tree;
+	arc_ref a;
+	tcaptype bottleneck;
+
+	/* 1. Finding bottleneck capacity */
+	/* 1a - the source tree */
+	bottleneck = A(middle_arc).r_cap;
+	for (k=s; (a=I.nodes[k].parent)!=TERMINAL; k=(int)(&N(A(a).head) - nodes))
+	{
+		if (bottleneck > A(A(a).sister).r_cap) bottleneck = A(A(a).sister).r_cap;
+	}
+	if (bottleneck > nodes[k].tr_cap) bottleneck = nodes[k].tr_cap;
+	/* 1b - the sink tree */
+	for (k=t; (a=I.nodes[k].parent)!=TERMINAL; k=(int)(&N(A(a).head) - nodes))
+	{
+		if (bottleneck > A(a).r_cap) bottleneck = A(a).r_cap;
+	}
+	if (bottleneck > - nodes[k].tr_cap) bottleneck = - nodes[k].tr_cap;
+
+	/* 2. Augmenting */
+	/* 2a - the source tree */
+	A(A(middle_arc).sister).r_cap += bottleneck;
+	A(middle_arc).r_cap -= bottleneck;
+	for (k=s; (a=I.nodes[k].parent)!=TERMINAL; k=i)
+	{
+		i = (int)(&N(A(a).head) - nodes);
+		A(a).r_cap += bottleneck;
+		A(A(a).sister).r_cap -= bottleneck;
+		if (!A(A(a).sister).r_cap) I.set_orphan(k);
+	}
+	nodes[k].tr_cap -= bottleneck;
+	if (!nodes[k].tr_cap) I.set_orphan(k);
+	/* 2b - the sink tree */
+	for (k=t; (a=I.nodes[k].parent)!=TERMINAL; k=i)
+	{
+		i = (int)(&N(A(a).head) - nodes);
+		A(A(a).sister).r_cap += bottleneck;
+		A(a).r_cap -= bottleneck;
+		if (!A(a).r_cap) I.set_orphan(k);
+	}
+	nodes[k].tr_cap += bottleneck;
+	if (!nodes[k].tr_cap) I.set_orphan(k);
+
+	flow += bottleneck;
+
+	/* 3. Adoption, by increasing label */
+	for (tree=IB::SOURCE_TREE; tree<=IB::SINK_TREE; tree++)
+	{
+		int max_label = I.max_label(tree);
+		for (d=I.orphan_min[tree]; d<=I.orphan_max[tree]; d++)
+		{
+			while ((k = I.orphans[tree][d]) >= 0)
+			{
+				typename IB::node* v = &I.nodes[k];
+				I.orphans[tree][d] = v->next_orphan;
+				if (v->tree != tree || v->parent || v->label != d) continue;
+
+				if (d == 1)
+				{
+					if ((tree == IB::SOURCE_TREE) ? (nodes[k].tr_cap > 0) : (nodes[k].tr_cap < 0)) { v->parent = TERMINAL; continue; }
+				}
+				else
+				{
+					/* a parent of label d-1 */
+					for (a=v->current; a; a=A(a).next)
+					{
+						typename IB::node* u = &I.nodes[&N(A(a).head) - nodes];
+						if (u->tree == tree && u->label == d-1 && u->parent
+						 && ((tree == IB::SOURCE_TREE) ? A(A(a).sister).r_cap : A(a).r_cap)) break;
+					}
+					if (a) { v->parent = v->current = a; continue; }
+				}
+
+				/* none: the children of k become orphans, and k is processed again
+				   with the label after the lowest of its possible parents */
+				int min_label = max_label;
+				for (a=nodes[k].first; a; a=A(a).next)
+				{
+					i = (int)(&N(A(a).head) - nodes);
+					typename IB::node* u = &I.nodes[i];
+					if (u->tree != tree) continue;
+					if (u->parent == A(a).sister) I.set_orphan(i);
+					else if (u->label < min_label && ((tree == IB::SOURCE_TREE) ? A(A(a).sister).r_cap : A(a).r_cap)) min_label = u->label;
+				}
+				if (min_label < d) min_label = d;
+				if (min_label + 1 > max_label)
+				{
+					/* k leaves the tree; the nodes of the tree that could reach it
+					   (its children among them) scan their arcs again */
+					v->tree = IB::FREE;
+					for (a=nodes[k].first; a; a=A(a).next)
+					{
+						i = (int)(&N(A(a).head) - nodes);
+						if (I.nodes[i].tree == tree && ((tree == IB::SOURCE_TREE) ? A(A(a).sister).r_cap : A(a).r_cap)) I.push(i);
+					}
+				}
+				else
+				{
+					v->label = min_label + 1;
+					v->current = nodes[k].first;
+					I.set_orphan(k);
+					I.push(k);
+				}
+			}
+		}
+		I.orphan_min[tree] = I.n + 2;
+		I.orphan_max[tree] = 0;
+	}
+}
+
+#include "instances.inc"
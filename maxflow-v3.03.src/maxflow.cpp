@@ -2,18 +2,40 @@
 
 
 #include <stdio.h>
+#include <time.h>
 #include "graph.h"
 
 
 /*
 	special constants for node->parent. Duplicated in graph.cpp, both should match!
 */
-#define TERMINAL ( (arc *) 1 )		/* to terminal */
-#define ORPHAN   ( (arc *) 2 )		/* orphan */
+#define TERMINAL ( (arc_ref) 1 )		/* to terminal */
+#define ORPHAN   ( (arc_ref) 2 )		/* orphan */
 
 
 #define INFINITE_D ((int)(((unsigned)-1)/2))		/* infinite distance to the terminal */
 
+/*
+	STATS(x) is x if the statistics of maxflow() are compiled in (MAXFLOW_STATS),
+	nothing otherwise. STATS_TIME(t) is the time in seconds.
+*/
+#ifdef MAXFLOW_STATS
+#include <chrono>
+#define STATS(x) x
+#define STATS_TIME(t) double t = std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count()
+#else
+#define STATS(x)
+#define STATS_TIME(t)
+#endif
+
+/*
+	Nodes and arcs are handled through their links (node_ref, arc_ref),
+	so that the same code works for all layouts: N(i) is the node i refers to,
+	A(a) is the arc a refers to, and a null link is 0. The tree state of a node
+	(parent, TS, DIST, is_sink) is always accessed through T(i), which is N(i)
+	itself unless the layout stores it apart.
+*/
+
 /***********************************************************************/
 
 /*
@@ -22,24 +44,53 @@
 	(or to i, if i is the last node in the list).
 	If i->next is NULL iff i is not in the list.
 
-	There are two queues. Active nodes are added
+	With GRAPH_FIFO there are two queues. Active nodes are added
 	to the end of the second queue and read from
 	the front of the first queue. If the first queue
 	is empty, it is replaced by the second queue
 	(and the second queue becomes empty).
+
+	With GRAPH_LIFO the first queue is a stack. With GRAPH_ALTERNATE the
+	first queue holds the nodes of the source tree and the second those
+	of the sink tree, and they are read in turn. With GRAPH_DISTANCE
+	there is one queue per distance to the terminal (bucket_first[d],
+	bucket_last[d]), read from the smallest distance. In all cases the
+	second queue is the list of nodes marked by mark_node() between two
+	calls to maxflow().
 */
 
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::set_active(node *i)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::set_active(node_ref i)
 {
-	if (!i->next)
+	if (!N(i).next)
 	{
 		/* it's not in the list yet */
-		if (queue_last[1]) queue_last[1] -> next = i;
-		else               queue_first[1]        = i;
-		queue_last[1] = i;
-		i -> next = i;
+		if (schedule == GRAPH_LIFO)
+		{
+			N(i).next = (queue_first[0]) ? queue_first[0] : i;
+			queue_first[0] = i;
+		}
+		else if (schedule == GRAPH_DISTANCE)
+		{
+			int d = T(i).DIST;
+			if (d < 0 || d >= node_num) d = 0; /* a node not in a tree yet */
+			if (d >= bucket_num) reallocate_buckets(d);
+			if (bucket_last[d]) N(bucket_last[d]).next = i;
+			else                bucket_first[d]        = i;
+			bucket_last[d] = i;
+			N(i).next = i;
+			if (bucket_min > d) bucket_min = d;
+			if (bucket_max < d) bucket_max = d;
+		}
+		else
+		{
+			int r = (schedule == GRAPH_ALTERNATE && !T(i).is_sink) ? 0 : 1;
+			if (queue_last[r]) N(queue_last[r]).next = i;
+			else               queue_first[r]        = i;
+			queue_last[r] = i;
+			N(i).next = i;
+		}
 	}
 }
 
@@ -48,154 +99,201 @@ template <typename captype, typename tcaptype, typename flowtype>
 	If it is connected to the sink, it stays in the list,
 	otherwise it is removed from the list
 */
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline typename Graph<captype,tcaptype,flowtype>::node* Graph<captype,tcaptype,flowtype>::next_active()
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline typename Graph<captype,tcaptype,flowtype,layout,schedule>::node_ref Graph<captype,tcaptype,flowtype,layout,schedule>::next_active()
 {
-	node *i;
+	node_ref i;
+	int r;
 
 	while ( 1 )
 	{
-		if (!(i=queue_first[0]))
+		if (schedule == GRAPH_LIFO)
 		{
-			queue_first[0] = i = queue_first[1];
-			queue_last[0]  = queue_last[1];
-			queue_first[1] = NULL;
-			queue_last[1]  = NULL;
-			if (!i) return NULL;
+			if (!(i=queue_first[0])) return 0;
+			queue_first[0] = (N(i).next == i) ? 0 : N(i).next;
 		}
+		else if (schedule == GRAPH_DISTANCE)
+		{
+			while (bucket_min <= bucket_max && !bucket_first[bucket_min]) bucket_min ++;
+			if (bucket_min > bucket_max) { bucket_min = INFINITE_D; bucket_max = -1; return 0; }
+			i = bucket_first[bucket_min];
+			if (N(i).next == i) bucket_first[bucket_min] = bucket_last[bucket_min] = 0;
+			else                bucket_first[bucket_min] = N(i).next;
+		}
+		else
+		{
+			if (schedule == GRAPH_ALTERNATE)
+			{
+				r = alternate;
+				if (!queue_first[r]) r = 1 - r;
+				if (!queue_first[r]) return 0;
+				alternate = 1 - r;
+			}
+			else
+			{
+				r = 0;
+				if (!queue_first[0])
+				{
+					queue_first[0] = queue_first[1];
+					queue_last[0]  = queue_last[1];
+					queue_first[1] = 0;
+					queue_last[1]  = 0;
+					if (!queue_first[0]) return 0;
+				}
+			}
+			i = queue_first[r];
 
-		/* remove it from the active list */
-		if (i->next == i) queue_first[0] = queue_last[0] = NULL;
-		else              queue_first[0] = i -> next;
-		i -> next = NULL;
+			/* remove it from the active list */
+			if (N(i).next == i) queue_first[r] = queue_last[r] = 0;
+			else                queue_first[r] = N(i).next;
+		}
+		N(i).next = 0;
 
 		/* a node in the list is active iff it has a parent */
-		if (i->parent) return i;
+		if (T(i).parent) return i;
 	}
 }
 
+/* makes room in bucket_first and bucket_last for distance d */
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::reallocate_buckets(int d)
+{
+	int num = (2*bucket_num > d+1) ? 2*bucket_num : d+1;
+	if (num < 64) num = 64;
+	node_ref* first = (node_ref*) realloc(bucket_first, num*sizeof(node_ref));
+	if (first) bucket_first = first;
+	node_ref* last = (node_ref*) realloc(bucket_last, num*sizeof(node_ref));
+	if (last) bucket_last = last;
+	if (!first || !last) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+	memset(bucket_first + bucket_num, 0, (num - bucket_num)*sizeof(node_ref));
+	memset(bucket_last + bucket_num, 0, (num - bucket_num)*sizeof(node_ref));
+	bucket_num = num;
+}
+
 /***********************************************************************/
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::set_orphan_front(node *i)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::set_orphan_front(node_ref i)
 {
-	nodeptr *np;
-	i -> parent = ORPHAN;
-	np = nodeptr_block -> New();
-	np -> ptr = i;
-	np -> next = orphan_first;
-	orphan_first = np;
+	T(i).parent = ORPHAN;
+	orphan_queue -> PushFront(i);
+	STATS(stats.orphan_pushes ++);
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::set_orphan_rear(node *i)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::set_orphan_rear(node_ref i)
 {
-	nodeptr *np;
-	i -> parent = ORPHAN;
-	np = nodeptr_block -> New();
-	np -> ptr = i;
-	if (orphan_last) orphan_last -> next = np;
-	else             orphan_first        = np;
-	orphan_last = np;
-	np -> next = NULL;
+	T(i).parent = ORPHAN;
+	orphan_queue -> PushBack(i);
+	STATS(stats.orphan_pushes ++);
 }
 
 /***********************************************************************/
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	inline void Graph<captype,tcaptype,flowtype>::add_to_changed_list(node *i)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	inline void Graph<captype,tcaptype,flowtype,layout,schedule>::add_to_changed_list(node_ref i)
 {
-	if (changed_list && !i->is_in_changed_list)
+	if (changed_list && !N(i).is_in_changed_list)
 	{
 		node_id* ptr = changed_list->New();
-		*ptr = (node_id)(i - nodes);
-		i->is_in_changed_list = true;
+		*ptr = node_name((node_id)(&N(i) - nodes));
+		N(i).is_in_changed_list = true;
 	}
 }
 
 /***********************************************************************/
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::maxflow_init()
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::maxflow_init()
 {
-	node *i;
+	node_ref i;
 
-	queue_first[0] = queue_last[0] = NULL;
-	queue_first[1] = queue_last[1] = NULL;
-	orphan_first = NULL;
+	queue_first[0] = queue_last[0] = 0;
+	queue_first[1] = queue_last[1] = 0;
+	bucket_min = INFINITE_D;
+	bucket_max = -1;
+	alternate = 0;
+	orphan_queue -> Reset();
 
 	TIME = 0;
 
-	for (i=nodes; i<node_last; i++)
+	for (i=NREF(nodes+part_first); i!=NREF(node_last); i++)
 	{
-		i -> next = NULL;
-		i -> is_marked = 0;
-		i -> is_in_changed_list = 0;
-		i -> TS = TIME;
-		if (i->tr_cap > 0)
+		/* a node fixed by fix_persistent_nodes() has no residual arc out of its
+		   tree, unless HPF or IBFS has moved flow since */
+		bool grow = !N(i).is_fixed || algorithm != BK;
+
+		N(i).next = 0;
+		N(i).is_marked = 0;
+		N(i).is_in_changed_list = 0;
+		N(i).is_fixed = 0;
+		T(i).TS = TIME;
+		if (N(i).tr_cap > 0)
 		{
 			/* i is connected to the source */
-			i -> is_sink = 0;
-			i -> parent = TERMINAL;
-			set_active(i);
-			i -> DIST = 1;
+			T(i).is_sink = 0;
+			T(i).parent = TERMINAL;
+			T(i).DIST = 1;
+			if (grow) set_active(i);
 		}
-		else if (i->tr_cap < 0)
+		else if (N(i).tr_cap < 0)
 		{
 			/* i is connected to the sink */
-			i -> is_sink = 1;
-			i -> parent = TERMINAL;
-			set_active(i);
-			i -> DIST = 1;
+			T(i).is_sink = 1;
+			T(i).parent = TERMINAL;
+			T(i).DIST = 1;
+			if (grow) set_active(i);
 		}
 		else
 		{
-			i -> parent = NULL;
+			T(i).parent = 0;
 		}
 	}
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::maxflow_reuse_trees_init()
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::maxflow_reuse_trees_init()
 {
-	node* i;
-	node* j;
-	node* queue = queue_first[1];
-	arc* a;
-	nodeptr* np;
-
-	queue_first[0] = queue_last[0] = NULL;
-	queue_first[1] = queue_last[1] = NULL;
-	orphan_first = orphan_last = NULL;
+	node_ref i;
+	node_ref j;
+	node_ref queue = queue_first[1];
+	arc_ref a;
+
+	queue_first[0] = queue_last[0] = 0;
+	queue_first[1] = queue_last[1] = 0;
+	bucket_min = INFINITE_D;
+	bucket_max = -1;
+	alternate = 0;
+	orphan_queue -> Reset();
 
 	TIME ++;
 
 	while ((i=queue))
 	{
-		queue = i->next;
-		if (queue == i) queue = NULL;
-		i->next = NULL;
-		i->is_marked = 0;
+		queue = N(i).next;
+		if (queue == i) queue = 0;
+		N(i).next = 0;
+		N(i).is_marked = 0;
 		set_active(i);
 
-		if (i->tr_cap == 0)
+		if (N(i).tr_cap == 0)
 		{
-			if (i->parent) set_orphan_rear(i);
+			if (T(i).parent) set_orphan_rear(i);
 			continue;
 		}
 
-		if (i->tr_cap > 0)
+		if (N(i).tr_cap > 0)
 		{
-			if (!i->parent || i->is_sink)
+			if (!T(i).parent || T(i).is_sink)
 			{
-				i->is_sink = 0;
-				for (a=i->first; a; a=a->next)
+				T(i).is_sink = 0;
+				for (a=N(i).first; a; a=A(a).next)
 				{
-					j = a->head;
-					if (!j->is_marked)
+					j = A(a).head;
+					if (!N(j).is_marked)
 					{
-						if (j->parent == a->sister) set_orphan_rear(j);
-						if (j->parent && j->is_sink && a->r_cap > 0) set_active(j);
+						if (T(j).parent == A(a).sister) set_orphan_rear(j);
+						if (T(j).parent && T(j).is_sink && A(a).r_cap > 0) set_active(j);
 					}
 				}
 				add_to_changed_list(i);
@@ -203,105 +301,183 @@ template <typename captype, typename tcaptype, typename flowtype>
 		}
 		else
 		{
-			if (!i->parent || !i->is_sink)
+			if (!T(i).parent || !T(i).is_sink)
 			{
-				i->is_sink = 1;
-				for (a=i->first; a; a=a->next)
+				T(i).is_sink = 1;
+				for (a=N(i).first; a; a=A(a).next)
 				{
-					j = a->head;
-					if (!j->is_marked)
+					j = A(a).head;
+					if (!N(j).is_marked)
 					{
-						if (j->parent == a->sister) set_orphan_rear(j);
-						if (j->parent && !j->is_sink && a->sister->r_cap > 0) set_active(j);
+						if (T(j).parent == A(a).sister) set_orphan_rear(j);
+						if (T(j).parent && !T(j).is_sink && A(A(a).sister).r_cap > 0) set_active(j);
 					}
 				}
 				add_to_changed_list(i);
 			}
 		}
-		i->parent = TERMINAL;
-		i -> TS = TIME;
-		i -> DIST = 1;
+		T(i).parent = TERMINAL;
+		T(i).TS = TIME;
+		T(i).DIST = 1;
 	}
 
 	//test_consistency();
 
 	/* adoption */
-	while ((np=orphan_first))
+	while (!orphan_queue -> IsEmpty())
 	{
-		orphan_first = np -> next;
-		i = np -> ptr;
-		nodeptr_block -> Delete(np);
-		if (!orphan_first) orphan_last = NULL;
-		if (i->is_sink) process_sink_orphan(i);
-		else            process_source_orphan(i);
+		i = orphan_queue -> PopFront();
+		if (T(i).is_sink) process_sink_orphan(i);
+		else              process_source_orphan(i);
 	}
 	/* adoption end */
 
 	//test_consistency();
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::augment(arc *middle_arc)
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	int Graph<captype,tcaptype,flowtype,layout,schedule>::fix_persistent_nodes()
 {
-	node *i;
-	arc *a;
+	node_ref i, j;
+	arc_ref a;
+	flowtype cap;
+	captype c;
+	int fixed_num = 0;
+
+	/*
+		Saturating the arcs of i pushes flow from the source through i to its
+		neighbours (or from them through i to the sink), what a neighbour cannot
+		send on to the other terminal going to its t-link, as in add_tweights():
+		this changes every cut by the same amount. The arcs between i and a
+		node already fixed are not cut, or are already saturated.
+	*/
+	for (i=NREF(nodes); i!=NREF(node_last); i++)
+	{
+		if (N(i).tr_cap > 0)
+		{
+			for (cap=0, a=N(i).first; a; a=A(a).next)
+			{
+				if (A(a).r_cap && !N(A(a).head).is_fixed) cap += A(a).r_cap;
+				if (cap > N(i).tr_cap) break;
+			}
+			if (a) continue;
+
+			if (cap) for (a=N(i).first; a; a=A(a).next)
+			{
+				j = A(a).head;
+				c = A(a).r_cap;
+				if (!c || N(j).is_fixed) continue;
+				A(a).r_cap = 0;
+				A(A(a).sister).r_cap += c;
+				N(i).tr_cap -= c;
+				if (N(j).tr_cap < 0) flow += (-N(j).tr_cap < c) ? -N(j).tr_cap : c;
+				N(j).tr_cap += c;
+			}
+			/* with a t-link left, i stays in the source tree */
+			if (N(i).tr_cap > 0) { N(i).is_fixed = 1; fixed_num ++; }
+		}
+		else if (N(i).tr_cap < 0)
+		{
+			for (cap=0, a=N(i).first; a; a=A(a).next)
+			{
+				if (A(A(a).sister).r_cap && !N(A(a).head).is_fixed) cap += A(A(a).sister).r_cap;
+				if (cap > -N(i).tr_cap) break;
+			}
+			if (a) continue;
+
+			if (cap) for (a=N(i).first; a; a=A(a).next)
+			{
+				j = A(a).head;
+				c = A(A(a).sister).r_cap;
+				if (!c || N(j).is_fixed) continue;
+				A(A(a).sister).r_cap = 0;
+				A(a).r_cap += c;
+				N(i).tr_cap += c;
+				if (N(j).tr_cap > 0) flow += (N(j).tr_cap < c) ? N(j).tr_cap : c;
+				N(j).tr_cap -= c;
+			}
+			/* with a t-link left, i stays in the sink tree */
+			if (N(i).tr_cap < 0) { N(i).is_fixed = 1; fixed_num ++; }
+		}
+	}
+
+	return fixed_num;
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::augment(arc_ref middle_arc)
+{
+	node_ref i;
+	arc_ref a;
 	tcaptype bottleneck;
 
 
 	/* 1. Finding bottleneck capacity */
 	/* 1a - the source tree */
-	bottleneck = middle_arc -> r_cap;
-	for (i=middle_arc->sister->head; ; i=a->head)
+	STATS(int path_length = 1);
+	bottleneck = A(middle_arc).r_cap;
+	for (i=A(A(middle_arc).sister).head; ; i=A(a).head)
 	{
-		a = i -> parent;
+		a = T(i).parent;
 		if (a == TERMINAL) break;
-		if (bottleneck > a->sister->r_cap) bottleneck = a -> sister -> r_cap;
+		STATS(path_length ++);
+		if (bottleneck > A(A(a).sister).r_cap) bottleneck = A(A(a).sister).r_cap;
 	}
-	if (bottleneck > i->tr_cap) bottleneck = i -> tr_cap;
+	if (bottleneck > N(i).tr_cap) bottleneck = N(i).tr_cap;
 	/* 1b - the sink tree */
-	for (i=middle_arc->head; ; i=a->head)
+	for (i=A(middle_arc).head; ; i=A(a).head)
 	{
-		a = i -> parent;
+		a = T(i).parent;
 		if (a == TERMINAL) break;
-		if (bottleneck > a->r_cap) bottleneck = a -> r_cap;
+		STATS(path_length ++);
+		if (bottleneck > A(a).r_cap) bottleneck = A(a).r_cap;
 	}
-	if (bottleneck > - i->tr_cap) bottleneck = - i -> tr_cap;
+	if (bottleneck > - N(i).tr_cap) bottleneck = - N(i).tr_cap;
+#ifdef MAXFLOW_STATS
+	stats.augmentations ++;
+	stats.path_length += path_length;
+	if (stats.max_path_length < path_length) stats.max_path_length = path_length;
+#endif
 
 
 	/* 2. Augmenting */
 	/* 2a - the source tree */
-	middle_arc -> sister -> r_cap += bottleneck;
-	middle_arc -> r_cap -= bottleneck;
-	for (i=middle_arc->sister->head; ; i=a->head)
+	A(A(middle_arc).sister).r_cap += bottleneck;
+	A(middle_arc).r_cap -= bottleneck;
+	for (i=A(A(middle_arc).sister).head; ; i=A(a).head)
 	{
-		a = i -> parent;
+		a = T(i).parent;
 		if (a == TERMINAL) break;
-		a -> r_cap += bottleneck;
-		a -> sister -> r_cap -= bottleneck;
-		if (!a->sister->r_cap)
+		A(a).r_cap += bottleneck;
+		A(A(a).sister).r_cap -= bottleneck;
+		if (!A(A(a).sister).r_cap)
 		{
 			set_orphan_front(i); // add i to the beginning of the adoption list
 		}
 	}
-	i -> tr_cap -= bottleneck;
-	if (!i->tr_cap)
+	N(i).tr_cap -= bottleneck;
+	if (!N(i).tr_cap)
 	{
 		set_orphan_front(i); // add i to the beginning of the adoption list
 	}
 	/* 2b - the sink tree */
-	for (i=middle_arc->head; ; i=a->head)
+	for (i=A(middle_arc).head; ; i=A(a).head)
 	{
-		a = i -> parent;
+		a = T(i).parent;
 		if (a == TERMINAL) break;
-		a -> sister -> r_cap += bottleneck;
-		a -> r_cap -= bottleneck;
-		if (!a->r_cap)
+		A(A(a).sister).r_cap += bottleneck;
+		A(a).r_cap -= bottleneck;
+		if (!A(a).r_cap)
 		{
 			set_orphan_front(i); // add i to the beginning of the adoption list
 		}
 	}
-	i -> tr_cap += bottleneck;
-	if (!i->tr_cap)
+	N(i).tr_cap += bottleneck;
+	if (!N(i).tr_cap)
 	{
 		set_orphan_front(i); // add i to the beginning of the adoption list
 	}
@@ -312,39 +488,42 @@ template <typename captype, typename tcaptype, typename flowtype>
 
 /***********************************************************************/
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::process_source_orphan(node *i)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::process_source_orphan(node_ref i)
 {
-	node *j;
-	arc *a0, *a0_min = NULL, *a;
+	node_ref j;
+	arc_ref a0, a0_min = 0, a;
 	int d, d_min = INFINITE_D;
 
+	STATS(stats.orphans ++);
+
 	/* trying to find a new parent */
-	for (a0=i->first; a0; a0=a0->next)
-	if (a0->sister->r_cap)
+	for (a0=N(i).first; a0; a0=A(a0).next)
+	if (A(A(a0).sister).r_cap)
 	{
-		j = a0 -> head;
-		if (!j->is_sink && (a=j->parent))
+		j = A(a0).head;
+		if (!T(j).is_sink && (a=T(j).parent))
 		{
 			/* checking the origin of j */
 			d = 0;
 			while ( 1 )
 			{
-				if (j->TS == TIME)
+				if (T(j).TS == TIME)
 				{
-					d += j -> DIST;
+					d += T(j).DIST;
 					break;
 				}
-				a = j -> parent;
+				a = T(j).parent;
 				d ++;
+				STATS(stats.origin_walk ++);
 				if (a==TERMINAL)
 				{
-					j -> TS = TIME;
-					j -> DIST = 1;
+					T(j).TS = TIME;
+					T(j).DIST = 1;
 					break;
 				}
 				if (a==ORPHAN) { d = INFINITE_D; break; }
-				j = a -> head;
+				j = A(a).head;
 			}
 			if (d<INFINITE_D) /* j originates from the source - done */
 			{
@@ -354,33 +533,36 @@ template <typename captype, typename tcaptype, typename flowtype>
 					d_min = d;
 				}
 				/* set marks along the path */
-				for (j=a0->head; j->TS!=TIME; j=j->parent->head)
+				for (j=A(a0).head; T(j).TS!=TIME; j=A(T(j).parent).head)
 				{
-					j -> TS = TIME;
-					j -> DIST = d --;
+					T(j).TS = TIME;
+					T(j).DIST = d --;
 				}
 			}
 		}
 	}
 
-	if (i->parent = a0_min)
+	if ((T(i).parent = a0_min))
 	{
-		i -> TS = TIME;
-		i -> DIST = d_min + 1;
+		T(i).TS = TIME;
+		T(i).DIST = d_min + 1;
 	}
 	else
 	{
 		/* no parent is found */
 		add_to_changed_list(i);
 
-		/* process neighbors */
-		for (a0=i->first; a0; a0=a0->next)
+		/* process neighbors; the arc to a child of i has residual capacity,
+		   so neighbors across an arc without any are left alone (ParallelGraph
+		   relies on it to solve parts of the graph concurrently) */
+		for (a0=N(i).first; a0; a0=A(a0).next)
+		if (A(a0).r_cap || A(A(a0).sister).r_cap)
 		{
-			j = a0 -> head;
-			if (!j->is_sink && (a=j->parent))
+			j = A(a0).head;
+			if (!T(j).is_sink && (a=T(j).parent))
 			{
-				if (a0->sister->r_cap) set_active(j);
-				if (a!=TERMINAL && a!=ORPHAN && a->head==i)
+				if (A(A(a0).sister).r_cap) set_active(j);
+				if (a!=TERMINAL && a!=ORPHAN && A(a).head==i)
 				{
 					set_orphan_rear(j); // add j to the end of the adoption list
 				}
@@ -389,39 +571,42 @@ template <typename captype, typename tcaptype, typename flowtype>
 	}
 }
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::process_sink_orphan(node *i)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::process_sink_orphan(node_ref i)
 {
-	node *j;
-	arc *a0, *a0_min = NULL, *a;
+	node_ref j;
+	arc_ref a0, a0_min = 0, a;
 	int d, d_min = INFINITE_D;
 
+	STATS(stats.orphans ++);
+
 	/* trying to find a new parent */
-	for (a0=i->first; a0; a0=a0->next)
-	if (a0->r_cap)
+	for (a0=N(i).first; a0; a0=A(a0).next)
+	if (A(a0).r_cap)
 	{
-		j = a0 -> head;
-		if (j->is_sink && (a=j->parent))
+		j = A(a0).head;
+		if (T(j).is_sink && (a=T(j).parent))
 		{
 			/* checking the origin of j */
 			d = 0;
 			while ( 1 )
 			{
-				if (j->TS == TIME)
+				if (T(j).TS == TIME)
 				{
-					d += j -> DIST;
+					d += T(j).DIST;
 					break;
 				}
-				a = j -> parent;
+				a = T(j).parent;
 				d ++;
+				STATS(stats.origin_walk ++);
 				if (a==TERMINAL)
 				{
-					j -> TS = TIME;
-					j -> DIST = 1;
+					T(j).TS = TIME;
+					T(j).DIST = 1;
 					break;
 				}
 				if (a==ORPHAN) { d = INFINITE_D; break; }
-				j = a -> head;
+				j = A(a).head;
 			}
 			if (d<INFINITE_D) /* j originates from the sink - done */
 			{
@@ -431,33 +616,34 @@ template <typename captype, typename tcaptype, typename flowtype>
 					d_min = d;
 				}
 				/* set marks along the path */
-				for (j=a0->head; j->TS!=TIME; j=j->parent->head)
+				for (j=A(a0).head; T(j).TS!=TIME; j=A(T(j).parent).head)
 				{
-					j -> TS = TIME;
-					j -> DIST = d --;
+					T(j).TS = TIME;
+					T(j).DIST = d --;
 				}
 			}
 		}
 	}
 
-	if (i->parent = a0_min)
+	if ((T(i).parent = a0_min))
 	{
-		i -> TS = TIME;
-		i -> DIST = d_min + 1;
+		T(i).TS = TIME;
+		T(i).DIST = d_min + 1;
 	}
 	else
 	{
 		/* no parent is found */
 		add_to_changed_list(i);
 
-		/* process neighbors */
-		for (a0=i->first; a0; a0=a0->next)
+		/* process neighbors (see process_source_orphan()) */
+		for (a0=N(i).first; a0; a0=A(a0).next)
+		if (A(a0).r_cap || A(A(a0).sister).r_cap)
 		{
-			j = a0 -> head;
-			if (j->is_sink && (a=j->parent))
+			j = A(a0).head;
+			if (T(j).is_sink && (a=T(j).parent))
 			{
-				if (a0->r_cap) set_active(j);
-				if (a!=TERMINAL && a!=ORPHAN && a->head==i)
+				if (A(a0).r_cap) set_active(j);
+				if (a!=TERMINAL && a!=ORPHAN && A(a).head==i)
 				{
 					set_orphan_rear(j); // add j to the end of the adoption list
 				}
@@ -468,34 +654,77 @@ template <typename captype, typename tcaptype, typename flowtype>
 
 /***********************************************************************/
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	flowtype Graph<captype,tcaptype,flowtype>::maxflow(bool reuse_trees, Block<node_id>* _changed_list)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	flowtype Graph<captype,tcaptype,flowtype,layout,schedule>::maxflow(bool reuse_trees, Block<node_id>* _changed_list)
 {
-	node *i, *j, *current_node = NULL;
-	arc *a;
-	nodeptr *np, *np_next;
+	STATS(memset(&stats, 0, sizeof(stats)));
+	STATS_TIME(t_init);
 
-	if (!nodeptr_block)
-	{
-		nodeptr_block = new DBlock<nodeptr>(NODEPTR_BLOCK_SIZE, error_function);
-	}
+	if (!orphan_queue) orphan_queue = new Deque<node_ref>(ORPHAN_QUEUE_SIZE, error_function);
 
 	changed_list = _changed_list;
 	if (maxflow_iteration == 0 && reuse_trees) { if (error_function) (*error_function)("reuse_trees cannot be used in the first call to maxflow()!"); exit(1); }
 	if (changed_list && !reuse_trees) { if (error_function) (*error_function)("changed_list cannot be used without reuse_trees!"); exit(1); }
 
+	if (!reuse_trees && algorithm != BK)
+	{
+		if (algorithm == HPF) pseudoflow();
+		else                  ibfs();
+		STATS_TIME(t_algorithm);
+		STATS(stats.algorithm_time = t_algorithm - t_init);
+		STATS(t_init = t_algorithm);
+	}
+
 	if (reuse_trees) maxflow_reuse_trees_init();
 	else             maxflow_init();
+	STATS_TIME(t_loop);
+	STATS(stats.init_time = t_loop - t_init);
+
+	return maxflow_loop(0);
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	flowtype Graph<captype,tcaptype,flowtype,layout,schedule>::resume(const char* filename)
+{
+	STATS(memset(&stats, 0, sizeof(stats)));
+
+	node_ref current_node = read_graph_file(filename, true);
+	if (!orphan_queue) orphan_queue = new Deque<node_ref>(ORPHAN_QUEUE_SIZE, error_function);
+	changed_list = NULL;
+
+	return maxflow_loop(current_node);
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	flowtype Graph<captype,tcaptype,flowtype,layout,schedule>::maxflow_loop(node_ref current_node)
+{
+	node_ref i, j;
+	arc_ref a;
+	int checkpoint_steps = 0;
+	time_t checkpoint_time = time(NULL) + checkpoint_interval;
+
+	STATS_TIME(t_grow);
 
 	// main loop
 	while ( 1 )
 	{
 		// test_consistency(current_node);
 
+		/* the state between two growth steps is the one a checkpoint saves */
+		if (checkpoint_file && ++checkpoint_steps == CHECKPOINT_STEPS)
+		{
+			checkpoint_steps = 0;
+			if (time(NULL) >= checkpoint_time)
+			{
+				write_checkpoint(current_node);
+				checkpoint_time = time(NULL) + checkpoint_interval;
+			}
+		}
+
 		if ((i=current_node))
 		{
-			i -> next = NULL; /* remove active flag */
-			if (!i->parent) i = NULL;
+			N(i).next = 0; /* remove active flag */
+			if (!T(i).parent) i = 0;
 		}
 		if (!i)
 		{
@@ -503,57 +732,58 @@ template <typename captype, typename tcaptype, typename flowtype>
 		}
 
 		/* growth */
-		if (!i->is_sink)
+		STATS(stats.growth_steps ++);
+		if (!T(i).is_sink)
 		{
 			/* grow source tree */
-			for (a=i->first; a; a=a->next)
-			if (a->r_cap)
+			for (a=N(i).first; a; a=A(a).next)
+			if (A(a).r_cap)
 			{
-				j = a -> head;
-				if (!j->parent)
+				j = A(a).head;
+				if (!T(j).parent)
 				{
-					j -> is_sink = 0;
-					j -> parent = a -> sister;
-					j -> TS = i -> TS;
-					j -> DIST = i -> DIST + 1;
+					T(j).is_sink = 0;
+					T(j).parent = A(a).sister;
+					T(j).TS = T(i).TS;
+					T(j).DIST = T(i).DIST + 1;
 					set_active(j);
 					add_to_changed_list(j);
 				}
-				else if (j->is_sink) break;
-				else if (j->TS <= i->TS &&
-				         j->DIST > i->DIST)
+				else if (T(j).is_sink) break;
+				else if (T(j).TS <= T(i).TS &&
+				         T(j).DIST > T(i).DIST)
 				{
 					/* heuristic - trying to make the distance from j to the source shorter */
-					j -> parent = a -> sister;
-					j -> TS = i -> TS;
-					j -> DIST = i -> DIST + 1;
+					T(j).parent = A(a).sister;
+					T(j).TS = T(i).TS;
+					T(j).DIST = T(i).DIST + 1;
 				}
 			}
 		}
 		else
 		{
 			/* grow sink tree */
-			for (a=i->first; a; a=a->next)
-			if (a->sister->r_cap)
+			for (a=N(i).first; a; a=A(a).next)
+			if (A(A(a).sister).r_cap)
 			{
-				j = a -> head;
-				if (!j->parent)
+				j = A(a).head;
+				if (!T(j).parent)
 				{
-					j -> is_sink = 1;
-					j -> parent = a -> sister;
-					j -> TS = i -> TS;
-					j -> DIST = i -> DIST + 1;
+					T(j).is_sink = 1;
+					T(j).parent = A(a).sister;
+					T(j).TS = T(i).TS;
+					T(j).DIST = T(i).DIST + 1;
 					set_active(j);
 					add_to_changed_list(j);
 				}
-				else if (!j->is_sink) { a = a -> sister; break; }
-				else if (j->TS <= i->TS &&
-				         j->DIST > i->DIST)
+				else if (!T(j).is_sink) { a = A(a).sister; break; }
+				else if (T(j).TS <= T(i).TS &&
+				         T(j).DIST > T(i).DIST)
 				{
 					/* heuristic - trying to make the distance from j to the sink shorter */
-					j -> parent = a -> sister;
-					j -> TS = i -> TS;
-					j -> DIST = i -> DIST + 1;
+					T(j).parent = A(a).sister;
+					T(j).TS = T(i).TS;
+					T(j).DIST = T(i).DIST + 1;
 				}
 			}
 		}
@@ -562,42 +792,38 @@ template <typename captype, typename tcaptype, typename flowtype>
 
 		if (a)
 		{
-			i -> next = i; /* set active flag */
+			N(i).next = i; /* set active flag */
 			current_node = i;
 
+			STATS_TIME(t_augment);
+			STATS(stats.growth_time += t_augment - t_grow);
+
 			/* augmentation */
 			augment(a);
 			/* augmentation end */
 
+			STATS_TIME(t_adopt);
+			STATS(stats.augment_time += t_adopt - t_augment);
+
 			/* adoption */
-			while ((np=orphan_first))
+			while (!orphan_queue -> IsEmpty())
 			{
-				np_next = np -> next;
-				np -> next = NULL;
-
-				while ((np=orphan_first))
-				{
-					orphan_first = np -> next;
-					i = np -> ptr;
-					nodeptr_block -> Delete(np);
-					if (!orphan_first) orphan_last = NULL;
-					if (i->is_sink) process_sink_orphan(i);
-					else            process_source_orphan(i);
-				}
-
-				orphan_first = np_next;
+				i = orphan_queue -> PopFront();
+				if (T(i).is_sink) process_sink_orphan(i);
+				else              process_source_orphan(i);
 			}
 			/* adoption end */
+
+			STATS_TIME(t_grow_next);
+			STATS(stats.adoption_time += t_grow_next - t_adopt; t_grow = t_grow_next);
 		}
-		else current_node = NULL;
+		else current_node = 0;
 	}
+	STATS_TIME(t_end);
+	STATS(stats.growth_time += t_end - t_grow);
 	// test_consistency();
 
-	if (!reuse_trees || (maxflow_iteration % 64) == 0)
-	{
-		delete nodeptr_block; 
-		nodeptr_block = NULL; 
-	}
+	STATS(stats.orphan_queue_size = orphan_queue -> Capacity());
 
 	maxflow_iteration ++;
 	return flow;
@@ -606,77 +832,81 @@ template <typename captype, typename tcaptype, typename flowtype>
 /***********************************************************************/
 
 
-template <typename captype, typename tcaptype, typename flowtype> 
-	void Graph<captype,tcaptype,flowtype>::test_consistency(node* current_node)
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule> 
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::test_consistency(node_ref current_node)
 {
-	node *i;
-	arc *a;
+	node_ref i;
+	arc_ref a;
 	int r;
 	int num1 = 0, num2 = 0;
 
 	// test whether all nodes i with i->next!=NULL are indeed in the queue
-	for (i=nodes; i<node_last; i++)
-	{
-		if (i->next || i==current_node) num1 ++;
-	}
-	for (r=0; r<3; r++)
+	// (only the two queues of GRAPH_FIFO and GRAPH_ALTERNATE are checked)
+	if (schedule == GRAPH_FIFO || schedule == GRAPH_ALTERNATE)
 	{
-		i = (r == 2) ? current_node : queue_first[r];
-		if (i)
-		for ( ; ; i=i->next)
+		for (i=NREF(nodes); i!=NREF(node_last); i++)
 		{
-			num2 ++;
-			if (i->next == i)
+			if (N(i).next || i==current_node) num1 ++;
+		}
+		for (r=0; r<3; r++)
+		{
+			i = (r == 2) ? current_node : queue_first[r];
+			if (i)
+			for ( ; ; i=N(i).next)
 			{
-				if (r<2) assert(i == queue_last[r]);
-				else     assert(i == current_node);
-				break;
+				num2 ++;
+				if (N(i).next == i)
+				{
+					if (r<2) assert(i == queue_last[r]);
+					else     assert(i == current_node);
+					break;
+				}
 			}
 		}
+		assert(num1 == num2);
 	}
-	assert(num1 == num2);
 
-	for (i=nodes; i<node_last; i++)
+	for (i=NREF(nodes); i!=NREF(node_last); i++)
 	{
 		// test whether all edges in seach trees are non-saturated
-		if (i->parent == NULL) {}
-		else if (i->parent == ORPHAN) {}
-		else if (i->parent == TERMINAL)
+		if (T(i).parent == 0) {}
+		else if (T(i).parent == ORPHAN) {}
+		else if (T(i).parent == TERMINAL)
 		{
-			if (!i->is_sink) assert(i->tr_cap > 0);
-			else             assert(i->tr_cap < 0);
+			if (!T(i).is_sink) assert(N(i).tr_cap > 0);
+			else               assert(N(i).tr_cap < 0);
 		}
 		else
 		{
-			if (!i->is_sink) assert (i->parent->sister->r_cap > 0);
-			else             assert (i->parent->r_cap > 0);
+			if (!T(i).is_sink) assert (A(A(T(i).parent).sister).r_cap > 0);
+			else               assert (A(T(i).parent).r_cap > 0);
 		}
 		// test whether passive nodes in search trees have neighbors in
 		// a different tree through non-saturated edges
-		if (i->parent && !i->next)
+		if (T(i).parent && !N(i).next)
 		{
-			if (!i->is_sink)
+			if (!T(i).is_sink)
 			{
-				assert(i->tr_cap >= 0);
-				for (a=i->first; a; a=a->next)
+				assert(N(i).tr_cap >= 0);
+				for (a=N(i).first; a; a=A(a).next)
 				{
-					if (a->r_cap > 0) assert(a->head->parent && !a->head->is_sink);
+					if (A(a).r_cap > 0) assert(T(A(a).head).parent && !T(A(a).head).is_sink);
 				}
 			}
 			else
 			{
-				assert(i->tr_cap <= 0);
-				for (a=i->first; a; a=a->next)
+				assert(N(i).tr_cap <= 0);
+				for (a=N(i).first; a; a=A(a).next)
 				{
-					if (a->sister->r_cap > 0) assert(a->head->parent && a->head->is_sink);
+					if (A(A(a).sister).r_cap > 0) assert(T(A(a).head).parent && T(A(a).head).is_sink);
 				}
 			}
 		}
 		// test marking invariants
-		if (i->parent && i->parent!=ORPHAN && i->parent!=TERMINAL)
+		if (T(i).parent && T(i).parent!=ORPHAN && T(i).parent!=TERMINAL)
 		{
-			assert(i->TS <= i->parent->head->TS);
-			if (i->TS == i->parent->head->TS) assert(i->DIST > i->parent->head->DIST);
+			assert(T(i).TS <= T(A(T(i).parent).head).TS);
+			if (T(i).TS == T(A(T(i).parent).head).TS) assert(T(i).DIST > T(A(T(i).parent).head).DIST);
 		}
 	}
 }
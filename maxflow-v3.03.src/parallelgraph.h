@@ -0,0 +1,321 @@
+/* parallelgraph.h */
+/*
+	ParallelGraph computes the same maximum flow and minimum cut as Graph,
+	with a parallel warm start and a serial finish: the regions of the graph
+	are solved once, concurrently, and one serial pass over the whole graph
+	then pushes the flow that crosses their boundaries.
+
+	The nodes are split into regions of consecutive nodes (for a grid:
+	horizontal strips). maxflow() then works as follows:
+
+		1. the arcs between regions (the boundary arcs) are saved in lists, one
+		   per slice of the edges scanned by a thread, and their residual
+		   capacities are set to 0;
+		2. every region is solved with BK, in parallel. Each region is a part
+		   of the Graph (see Graph::Graph(Graph*, node_id, node_id)): it runs
+		   on the nodes and arcs of the Graph, with its own active list,
+		   orphan queue and time, and since no residual arc leaves it, it only
+		   touches its own nodes and arcs. The search trees of the regions are
+		   kept in the Graph;
+		3. the boundary arcs get their residual capacities back and their ends
+		   are marked (see Graph::mark_node()), and Graph::maxflow(true) pushes
+		   the remaining flow from the search trees of 2.: it only starts from
+		   the nodes along the boundaries, and only goes as far from them as
+		   the remaining paths do.
+
+	Every flow pushed by a region is a flow of the whole graph, so 3. finishes
+	the maximum flow of the whole graph. The result is exact (for floating
+	point capacities, up to rounding: the flows are not summed in the same
+	order as by Graph). Moreover after Graph::maxflow() the nodes reachable
+	from the source in the final residual graph are the source tree, and the
+	nodes from which the sink is reachable are the sink tree. These sets are
+	the same for every maximum flow, so what_segment() returns exactly what it
+	returns for a Graph solved serially, for either default_segm.
+
+	The graph is stored once, in the Graph; the only extra memory is the lists
+	of boundary arcs.
+
+	There is a single parallel pass: the regions are not solved again after
+	the boundary flow is exchanged. 3. is serial, and its time grows with the
+	flow crossing the boundaries (see get_final_flow()): the threads only
+	help when most of the flow stays within the regions. No speedup over
+	Graph has been measured on several cores.
+*/
+
+#ifndef __PARALLELGRAPH_H__
+#define __PARALLELGRAPH_H__
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include "graph.h"
+
+
+
+// captype, tcaptype, flowtype, layout: as in Graph
+template <typename captype, typename tcaptype, typename flowtype, int layout = GRAPH_POINTERS> class ParallelGraph
+{
+public:
+	typedef Graph<captype,tcaptype,flowtype,layout> GraphType;
+	typedef typename GraphType::termtype termtype;
+	typedef int node_id;
+
+	/////////////////////////////////////////////////////////////////////////
+	//                     BASIC INTERFACE FUNCTIONS                       //
+	/////////////////////////////////////////////////////////////////////////
+
+	// Constructor, as Graph's. node_num_max and edge_num_max are estimates.
+	ParallelGraph(int node_num_max, int edge_num_max, void (*err_function)(const char *) = NULL);
+
+	// Destructor
+	~ParallelGraph();
+
+	// Same as in Graph. All nodes are initially in region 0.
+	node_id add_node(int num = 1) { return g -> add_node(num); }
+	void add_edge(node_id i, node_id j, captype cap, captype rev_cap) { g -> add_edge(i, j, cap, rev_cap); }
+	void add_tweights(node_id i, tcaptype cap_source, tcaptype cap_sink) { g -> add_tweights(i, cap_source, cap_sink); }
+
+	// Regions are made of consecutive nodes: region r goes from its first node
+	// to the first node of region r+1 (or to the last node). split_region(i)
+	// starts a new region at node 'i', which must be after the first node of
+	// the last region; clear_regions() puts all nodes back in region 0.
+	void split_region(node_id i);
+	void clear_regions() { region_first.assign(1, 0); }
+
+	// Regions for a width x height grid whose node (x,y) is y*width+x:
+	// 'strips' horizontal strips of equal height.
+	void set_grid_strips(int width, int height, int strips);
+
+	// Number of threads solving regions concurrently.
+	// Default is std::thread::hardware_concurrency().
+	void set_thread_num(int num) { thread_num = (num > 0) ? num : 1; }
+
+	// Computes the maxflow, as Graph::maxflow() without reuse_trees. Can be called
+	// several times, after adding edges and t-links.
+	flowtype maxflow();
+
+	// After the maxflow is computed, same as Graph::what_segment().
+	termtype what_segment(node_id i, termtype default_segm = GraphType::SOURCE) { return g -> what_segment(i, default_segm); }
+
+	int get_node_num() { return g -> get_node_num(); }
+	// flow pushed by the final serial pass along the boundaries in the last call to maxflow();
+	// the larger its share of the flow, the less the threads help
+	flowtype get_final_flow() { return final_flow; }
+
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+private:
+	// a region solved by one thread
+	struct region
+	{
+		flowtype				flow;		// flow pushed by the region
+		int						time;		// TIME of the region's search
+
+		// boundary arcs found by the thread in its slice of the arcs, and their residual
+		// capacities while the regions are solved
+		std::vector<typename GraphType::arc_id>	boundary;
+		std::vector<captype>					boundary_cap;
+	};
+
+	GraphType				*g;
+	std::vector<node_id>	region_first;		// first node of each region, in increasing order
+	std::vector<region>		regions;
+
+	flowtype				final_flow;
+
+	int						thread_num;
+
+	void	(*error_function)(const char *);
+
+	node_id region_last(int r) { return (r+1 < (int)region_first.size()) ? region_first[r+1] : get_node_num(); } // after the last node of region r
+	int region_of(node_id i) { return (int)(std::upper_bound(region_first.begin(), region_first.end(), i) - region_first.begin()) - 1; }
+	bool is_reverse(typename GraphType::arc_id a, typename GraphType::arc_id b) // b goes from the head of a to its tail
+	{
+		node_id i, j, b_i, b_j;
+		g -> get_arc_ends(a, i, j);
+		g -> get_arc_ends(b, b_i, b_j);
+		return b_i == j && b_j == i;
+	}
+	void run(void (ParallelGraph::*task)(int r)); // task(r) for every region, on thread_num threads
+	void cut_boundaries(int r);
+	void solve_region(int r);
+	void join_regions();
+};
+
+
+
+///////////////////////////////////////
+// Implementation                    //
+///////////////////////////////////////
+
+
+
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	ParallelGraph<captype,tcaptype,flowtype,layout>::ParallelGraph(int node_num_max, int edge_num_max, void (*err_function)(const char *))
+	: region_first(1, 0), final_flow(0), error_function(err_function)
+{
+	g = new GraphType(node_num_max, edge_num_max, err_function);
+
+	thread_num = (int)std::thread::hardware_concurrency();
+	if (thread_num < 1) thread_num = 1;
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	ParallelGraph<captype,tcaptype,flowtype,layout>::~ParallelGraph()
+{
+	delete g;
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	void ParallelGraph<captype,tcaptype,flowtype,layout>::split_region(node_id i)
+{
+	assert(i > region_first.back());
+
+	region_first.push_back(i);
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	void ParallelGraph<captype,tcaptype,flowtype,layout>::set_grid_strips(int width, int height, int strips)
+{
+	if (width*height > get_node_num()) { if (error_function) (*error_function)("Grid larger than the graph!"); exit(1); }
+	if (strips < 1) strips = 1;
+	if (strips > height) strips = height;
+
+	int strip_height = (height + strips - 1) / strips;
+	int y;
+
+	clear_regions();
+	for (y=strip_height; y<height; y+=strip_height) split_region(y*width);
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	void ParallelGraph<captype,tcaptype,flowtype,layout>::run(void (ParallelGraph::*task)(int r))
+{
+	int region_num = (int)regions.size(), t;
+	int n = (thread_num < region_num) ? thread_num : region_num;
+	std::atomic<int> next(0);
+	std::vector<std::thread> threads;
+
+	struct worker
+	{
+		static void run(ParallelGraph* pg, void (ParallelGraph::*task)(int r), int region_num, std::atomic<int>* next)
+		{
+			int r;
+			while ((r = (*next)++) < region_num) (pg->*task)(r);
+		}
+	};
+
+	for (t=1; t<n; t++) threads.push_back(std::thread(&worker::run, this, task, region_num, &next));
+	worker::run(this, task, region_num, &next);
+	for (t=0; t<(int)threads.size(); t++) threads[t].join();
+}
+
+/*
+	Saves the boundary arcs of slice r of the edges and sets their residual
+	capacities to 0. Once every slice is done, no residual arc joins two regions.
+*/
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	void ParallelGraph<captype,tcaptype,flowtype,layout>::cut_boundaries(int r)
+{
+	int edge_num = g->get_arc_num() / 2, region_num = (int)regions.size(), e;
+	int e_first = (int)((long long)edge_num * r / region_num), e_last = (int)((long long)edge_num * (r+1) / region_num);
+	typename GraphType::arc_id a = g->get_first_arc() + 2*e_first, b;
+	node_id i, j, first = 0, last = 0; // [first, last): region of the last i
+	region& R = regions[r];
+
+	R.boundary.clear();
+	R.boundary_cap.clear();
+	for (e=e_first; e<e_last; e++, a=g->get_next_arc(b))
+	{
+		/* the two arcs of an edge are consecutive: a = i->j, then b = j->i */
+		b = g -> get_next_arc(a);
+		g -> get_arc_ends(a, i, j);
+		assert(is_reverse(a, b));
+		if (i < first || i >= last)
+		{
+			int r_i = region_of(i);
+			first = region_first[r_i];
+			last = region_last(r_i);
+		}
+		if (j >= first && j < last) continue;
+
+		R.boundary.push_back(a);
+		R.boundary_cap.push_back(g->get_rcap(a));
+		g -> set_rcap(a, 0);
+		R.boundary.push_back(b);
+		R.boundary_cap.push_back(g->get_rcap(b));
+		g -> set_rcap(b, 0);
+	}
+}
+
+/*
+	Solves region r as a part of g. Parts share no node and no residual arc,
+	so they can be solved concurrently.
+*/
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	void ParallelGraph<captype,tcaptype,flowtype,layout>::solve_region(int r)
+{
+	node_id first = region_first[r], last = region_last(r);
+	region& R = regions[r];
+
+	R.flow = 0;
+	R.time = 0;
+	if (first >= last) return;
+
+	GraphType part(g, first, last);
+	R.flow = part.maxflow();
+	R.time = part.TIME;
+}
+
+/*
+	Gives g the state maxflow() would have left after pushing the flows of the
+	regions: their search trees are g's, so maxflow(true) can go on from them.
+*/
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	void ParallelGraph<captype,tcaptype,flowtype,layout>::join_regions()
+{
+	size_t r, k;
+	node_id i, j;
+
+	g -> queue_first[1] = g -> queue_last[1] = 0;
+	g -> TIME = 0;
+	for (r=0; r<regions.size(); r++)
+	{
+		g -> flow += regions[r].flow;
+		if (g->TIME < regions[r].time) g -> TIME = regions[r].time;
+	}
+	g -> maxflow_iteration ++;
+
+	for (r=0; r<regions.size(); r++)
+	for (k=0; k<regions[r].boundary.size(); k++)
+	{
+		g -> set_rcap(regions[r].boundary[k], regions[r].boundary_cap[k]);
+		if (regions[r].boundary_cap[k] == 0) continue;
+		g -> get_arc_ends(regions[r].boundary[k], i, j);
+		g -> mark_node(i);
+		g -> mark_node(j);
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype, int layout>
+	flowtype ParallelGraph<captype,tcaptype,flowtype,layout>::maxflow()
+{
+	regions.resize(region_first.size());
+	run(&ParallelGraph::cut_boundaries);
+	run(&ParallelGraph::solve_region);
+	join_regions();
+
+	flowtype flow = g -> flow;
+	final_flow = g -> maxflow(true) - flow;
+	return flow + final_flow;
+}
+
+
+#endif
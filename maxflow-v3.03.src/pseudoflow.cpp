@@ -0,0 +1,405 @@
+/* pseudoflow.cpp */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "graph.h"
+
+/*
+	Pseudoflow algorithm of Hochbaum ("The pseudoflow algorithm: a new
+	algorithm for the maximum-flow problem", Operations Research 56(4), 2008),
+	highest label variant, as in the implementation of Chandran and Hochbaum.
+
+	It works on the residual capacities of the graph (tr_cap and r_cap), so it
+	can start from the state left by a previous call to maxflow(). All t-links
+	are saturated at the start: the excess of node k is then its tr_cap, and the
+	nodes with a positive excess are 'strong'. The nodes are kept in a forest
+	whose arcs all have positive residual capacity, the excess of a tree being
+	at its root. A strong root of highest label looks in its tree for an arc
+	to a node labelled one less; the tree is hung from that node ('merge') and
+	its excess is pushed towards the new root, the tree being split at the
+	arcs that get saturated. A node without such an arc gets its label
+	increased. The strong nodes whose label no node has under them are cut
+	off from the sink ('gap') and put aside.
+
+	At the end no arc goes from a strong node to a weak node with a positive
+	residual capacity. The excess left at a strong root may be more than its
+	source t-link (excesses are summed in flowtype, they may not even fit in
+	tcaptype): the surplus is sent back along residual arcs to the nodes whose
+	source t-links it came from (flow recovery, see pseudoflow_recover()).
+	The excesses are then put back in the t-links, and the result is a maximum
+	flow in the representation of maxflow(). maxflow() then builds its search
+	trees on it, which finds no augmenting path.
+*/
+
+/*
+	State of the nodes during pseudoflow(): nodes[k] is the state of node k of
+	the graph. arc_ref is the type of the arc links of the graph.
+*/
+template <typename flowtype, typename arc_ref> class Pseudoflow
+{
+public:
+	struct node
+	{
+		flowtype	excess;		// excess of the node (0 unless the node is a root)
+		int			label;
+		int			parent;		// parent in the forest, -1 for a root
+		int			child;		// first child, -1 if none
+		int			next, prev;	// siblings (for a root: next root in the bucket of its label)
+		int			scan;		// next child to be visited by the walks of the tree
+		arc_ref		to_parent;	// arc to the parent
+		arc_ref		current;	// next arc to be scanned for a merge (0 if all were scanned)
+	};
+
+	Pseudoflow(int node_num) : n(node_num), highest(1)
+	{
+		nodes = (node*) malloc(n*sizeof(node));
+		label_count = (int*) calloc(n+2, sizeof(int));
+		bucket_first = (int*) malloc((n+2)*sizeof(int));
+		bucket_last = (int*) malloc((n+2)*sizeof(int));
+		if (bucket_first && bucket_last)
+		{
+			for (int l=0; l<n+2; l++) bucket_first[l] = bucket_last[l] = -1;
+		}
+	}
+
+	~Pseudoflow()
+	{
+		free(nodes);
+		free(label_count);
+		free(bucket_first);
+		free(bucket_last);
+	}
+
+	bool allocated() { return nodes && label_count && bucket_first && bucket_last; }
+
+	int			n;
+	node		*nodes;
+	int			*label_count;	// number of nodes of each label (the lifted ones are not counted)
+	int			*bucket_first, *bucket_last; // strong roots of each label
+	int			highest;		// label of the strong root being processed
+
+	void add_to_bucket_front(int k)
+	{
+		int l = nodes[k].label;
+		nodes[k].next = bucket_first[l];
+		bucket_first[l] = k;
+		if (bucket_last[l] < 0) bucket_last[l] = k;
+	}
+
+	void add_to_bucket_rear(int k)
+	{
+		int l = nodes[k].label;
+		nodes[k].next = -1;
+		if (bucket_last[l] >= 0) nodes[bucket_last[l]].next = k;
+		else                     bucket_first[l] = k;
+		bucket_last[l] = k;
+	}
+
+	int pop_bucket(int l)
+	{
+		int k = bucket_first[l];
+		bucket_first[l] = nodes[k].next;
+		if (bucket_first[l] < 0) bucket_last[l] = -1;
+		nodes[k].next = -1;
+		return k;
+	}
+
+	void add_child(int p, int k)
+	{
+		nodes[k].parent = p;
+		nodes[k].prev = -1;
+		nodes[k].next = nodes[p].child;
+		if (nodes[p].child >= 0) nodes[nodes[p].child].prev = k;
+		nodes[p].child = k;
+	}
+
+	void remove_child(int p, int k)
+	{
+		if (nodes[k].prev >= 0) nodes[nodes[k].prev].next = nodes[k].next;
+		else                    nodes[p].child = nodes[k].next;
+		if (nodes[k].next >= 0) nodes[nodes[k].next].prev = nodes[k].prev;
+		nodes[k].parent = -1;
+		nodes[k].next = nodes[k].prev = -1;
+	}
+
+	// puts the tree of root k aside: its nodes are cut off from the sink
+	void lift_all(int k)
+	{
+		nodes[k].scan = nodes[k].child;
+		label_count[nodes[k].label] --;
+		nodes[k].label = n;
+		for ( ; k >= 0; k = nodes[k].parent)
+		{
+			while (nodes[k].scan >= 0)
+			{
+				int c = nodes[k].scan;
+				nodes[k].scan = nodes[c].next;
+				k = c;
+				nodes[k].scan = nodes[k].child;
+				label_count[nodes[k].label] --;
+				nodes[k].label = n;
+			}
+		}
+	}
+
+	// strong root of highest label to be processed next, -1 if none is left
+	int next_strong_root()
+	{
+		int l;
+		for (l=highest; l>0; l--)
+		{
+			if (bucket_first[l] >= 0)
+			{
+				highest = l;
+				if (label_count[l-1] > 0) return pop_bucket(l);
+				while (bucket_first[l] >= 0) lift_all(pop_bucket(l)); // gap
+			}
+		}
+		if (bucket_first[0] < 0) return -1;
+		while (bucket_first[0] >= 0)
+		{
+			int k = pop_bucket(0);
+			label_count[0] --;
+			nodes[k].label = 1;
+			label_count[1] ++;
+			add_to_bucket_rear(k);
+		}
+		highest = 1;
+		return pop_bucket(1);
+	}
+
+	// moves the scan of the children of k to the next one with the label
+	// of k; if there is none, relabels k and returns true
+	bool check_children(int k)
+	{
+		for ( ; nodes[k].scan >= 0; nodes[k].scan = nodes[nodes[k].scan].next)
+		{
+			if (nodes[nodes[k].scan].label == nodes[k].label) return false;
+		}
+		label_count[nodes[k].label] --;
+		nodes[k].label ++;
+		label_count[nodes[k].label] ++;
+		return true;
+	}
+};
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule>
+	void Graph<captype,tcaptype,flowtype,layout,schedule>::pseudoflow()
+{
+	typedef Pseudoflow<flowtype, arc_ref> PF;
+	PF P(node_num);
+	typename PF::node *h;
+	int k, r, s, w, p;
+	arc_ref a;
+
+	if (!P.allocated()) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+
+	for (k=0; k<node_num; k++)
+	{
+		h = &P.nodes[k];
+		h->excess = nodes[k].tr_cap;
+		h->label = (h->excess > 0) ? 1 : 0;
+		h->parent = h->child = h->next = h->prev = h->scan = -1;
+		h->to_parent = 0;
+		h->current = nodes[k].first;
+		P.label_count[h->label] ++;
+		if (h->excess > 0)
+		{
+			flow += h->excess;
+			P.add_to_bucket_rear(k);
+		}
+	}
+
+	while ((r = P.next_strong_root()) >= 0)
+	{
+		/* depth first walk of the nodes of the tree of r with the label of r,
+		   looking for an arc to a node labelled one less */
+		s = r;
+		w = -1;
+		P.nodes[r].scan = P.nodes[r].child;
+		while (1)
+		{
+			h = &P.nodes[s];
+			for (a=h->current; a; a=A(a).next)
+			{
+				if (A(a).r_cap > 0 && P.nodes[&N(A(a).head) - nodes].label == P.highest - 1) break;
+			}
+			h->current = a;
+			if (a) { w = (int)(&N(A(a).head) - nodes); break; }
+			if (P.check_children(s)) h->current = nodes[s].first;
+
+			/* next node of the walk */
+			while (P.nodes[s].scan < 0 && (p = P.nodes[s].parent) >= 0)
+			{
+				s = p;
+				if (P.check_children(s)) P.nodes[s].current = nodes[s].first;
+			}
+			if (P.nodes[s].scan < 0) break;
+			k = P.nodes[s].scan;
+			P.nodes[s].scan = P.nodes[k].next;
+			s = k;
+			P.nodes[s].scan = P.nodes[s].child;
+		}
+
+		if (w < 0)
+		{
+			/* the whole walk was relabelled */
+			P.add_to_bucket_rear(r);
+			P.highest ++;
+			continue;
+		}
+
+		/* merge: make s the root of its tree, and hang it from w by the arc a */
+		{
+			int cur = s, new_parent = w;
+			arc_ref new_arc = a, old_arc;
+			while ((p = P.nodes[cur].parent) >= 0)
+			{
+				old_arc = P.nodes[cur].to_parent;
+				P.nodes[cur].to_parent = new_arc;
+				P.remove_child(p, cur);
+				P.add_child(new_parent, cur);
+				new_parent = cur;
+				cur = p;
+				new_arc = A(old_arc).sister;
+			}
+			P.nodes[cur].to_parent = new_arc;
+			P.add_child(new_parent, cur);
+		}
+
+		/* push the excess of r towards the root of w, splitting the
+		   tree at the arcs that get saturated */
+		{
+			int cur = r;
+			bool was_strong = true;
+			while (P.nodes[cur].excess > 0 && (p = P.nodes[cur].parent) >= 0)
+			{
+				arc& e = A(P.nodes[cur].to_parent);
+				flowtype x = P.nodes[cur].excess;
+				was_strong = (P.nodes[p].excess > 0);
+				if (e.r_cap < x)
+				{
+					x = e.r_cap;
+					P.remove_child(p, cur);
+					P.nodes[cur].excess -= x;
+					P.add_to_bucket_front(cur);
+				}
+				else P.nodes[cur].excess = 0;
+				e.r_cap -= (captype) x;
+				A(e.sister).r_cap += (captype) x;
+				P.nodes[p].excess += x;
+				cur = p;
+			}
+			if (P.nodes[cur].excess > 0 && !was_strong) P.add_to_bucket_rear(cur);
+		}
+	}
+
+	/* the excesses left are the residual capacities of the t-links */
+	pseudoflow_recover(P);
+	for (k=0; k<node_num; k++)
+	{
+		nodes[k].tr_cap = P.nodes[k].excess;
+		if (nodes[k].tr_cap > 0) flow -= nodes[k].tr_cap;
+	}
+}
+
+/*
+	Flow recovery: node k can take back up to max(tr_cap, 0) - excess (tr_cap
+	being still the one at the start of pseudoflow()). The surplus of a node
+	that holds more is sent back by breadth first searches along residual arcs
+	(which stay among the strong nodes): a search stops once the nodes found
+	can take the surplus, and what each subtree of the search tree can take
+	through its arc is then sent down the tree. The excess came from the
+	source t-links of strong nodes along arcs whose reverse now has residual
+	capacity, so every search finds room for part of the surplus.
+*/
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule>
+	template <class PF> void Graph<captype,tcaptype,flowtype,layout,schedule>::pseudoflow_recover(PF& P)
+{
+	int *queue = NULL, q, q_last, k, i, j, round = 0;
+	flowtype *amount = NULL; // what a node can take in, then what it has to send on
+	arc_ref a;
+
+#define PSEUDOFLOW_ROOM(k) ((flowtype) ((nodes[k].tr_cap > 0) ? nodes[k].tr_cap : 0) - P.nodes[k].excess)
+
+	for (k=0; k<node_num; k++)
+	{
+		flowtype surplus = -PSEUDOFLOW_ROOM(k);
+		if (surplus <= 0) continue;
+		if (!queue)
+		{
+			queue = (int*) malloc(node_num*sizeof(int));
+			amount = (flowtype*) malloc(node_num*sizeof(flowtype));
+			if (!queue || !amount) { if (error_function) (*error_function)("Not enough memory!"); exit(1); }
+			for (j=0; j<node_num; j++) P.nodes[j].scan = -1; // round of the last search that found j
+		}
+
+		while (surplus > 0)
+		{
+			flowtype room = 0, x;
+
+			queue[0] = k;
+			q_last = 1;
+			P.nodes[k].scan = round;
+			for (q=0; q<q_last && room<surplus; q++)
+			{
+				i = queue[q];
+				for (a=nodes[i].first; a; a=A(a).next)
+				if (A(a).r_cap > 0)
+				{
+					j = (int)(&N(A(a).head) - nodes);
+					if (P.nodes[j].scan == round) continue;
+					P.nodes[j].scan = round;
+					P.nodes[j].to_parent = a;
+					queue[q_last ++] = j;
+					if (PSEUDOFLOW_ROOM(j) > 0) room += PSEUDOFLOW_ROOM(j);
+				}
+			}
+			round ++;
+
+			/* what the subtree of each node can take */
+			for (q=0; q<q_last; q++) amount[queue[q]] = 0;
+			for (q=q_last-1; q>0; q--)
+			{
+				j = queue[q];
+				a = P.nodes[j].to_parent;
+				i = (int)(&N(A(A(a).sister).head) - nodes);
+				if (PSEUDOFLOW_ROOM(j) > 0) amount[j] += PSEUDOFLOW_ROOM(j);
+				amount[i] += (amount[j] < A(a).r_cap) ? amount[j] : (flowtype) A(a).r_cap;
+			}
+
+			x = (amount[k] < surplus) ? amount[k] : surplus;
+			if (x <= 0) break; // only rounding errors of floating point capacities are left
+			amount[k] = x;
+			P.nodes[k].excess -= x;
+			surplus -= x;
+
+			/* send it down the tree */
+			for (q=1; q<q_last; q++)
+			{
+				flowtype y, keep;
+				j = queue[q];
+				a = P.nodes[j].to_parent;
+				i = (int)(&N(A(A(a).sister).head) - nodes);
+				y = amount[i];
+				if (y > A(a).r_cap) y = A(a).r_cap;
+				if (y > amount[j]) y = amount[j];
+				amount[i] -= y;
+				A(a).r_cap -= (captype) y;
+				A(A(a).sister).r_cap += (captype) y;
+				keep = (PSEUDOFLOW_ROOM(j) > 0) ? PSEUDOFLOW_ROOM(j) : 0;
+				if (keep > y) keep = y;
+				P.nodes[j].excess += keep;
+				amount[j] = y - keep;
+			}
+		}
+	}
+
+#undef PSEUDOFLOW_ROOM
+
+	free(queue);
+	free(amount);
+}
+
+#include "instances.inc"
@@ -0,0 +1,684 @@
+/* tiledgraph.h */
+/*
+	TiledGridGraph computes the maximum flow and the minimum cut of a
+	4-connected grid (as GridGraph) that does not fit in memory.
+
+	The grid is cut in square tiles. The state of every node (its t-link and
+	the residual capacities of its four arcs) is kept in a page file on disk,
+	tile after tile; only a few tiles are in memory at a time, in a cache whose
+	size follows from the memory budget given to the constructor.
+
+	The capacities are read tile by tile from a GridTileSource, so the input
+	does not have to be in memory either.
+
+	maxflow() first solves one region at a time, by sweeps:
+
+		1. every tile is solved by a GridGraph, using only the arcs inside the
+		   tile, and its residual capacities are written back;
+		2. the same for the windows of the size of a tile shifted by half a tile
+		   in both directions, which contain the boundaries and corners of the
+		   tiles of 1.;
+		3. 1. and 2. are repeated while they push flow, for at most a given number
+		   of sweeps.
+
+	The remaining augmenting paths cross several tiles. They are found by
+	breadth-first searches from the source that visit the tiles through the
+	cache; a search augments every path of its tree that still has residual
+	capacity, and goes on. Each search starts from the tiles that still have
+	nodes connected to the source, and the labels of the previous search are
+	cleared in a tile when the search first loads it, so the tiles that it
+	does not reach are neither read nor written. When a search finds no path,
+	it has labelled the nodes reachable from the source, and a second search
+	labels the nodes from which the sink is reachable.
+	These are the source tree and the sink tree that Graph would leave, so
+	what_segment() gives the same segmentation as Graph (the flow is exact as
+	well; for floating point capacities, up to rounding).
+
+	The memory used is the tiles in the cache (at least 4 tiles) plus one
+	GridGraph of the size of a tile.
+*/
+
+#ifndef __TILEDGRAPH_H__
+#define __TILEDGRAPH_H__
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include "gridgraph.h"
+
+#ifdef _MSC_VER
+#define TILEDGRAPH_FSEEK _fseeki64
+typedef __int64 tiledgraph_off_t;
+#else
+#include <sys/types.h>
+#define TILEDGRAPH_FSEEK fseeko
+typedef off_t tiledgraph_off_t;
+#endif
+
+
+
+// Reader of the capacities of a grid, a block of nodes at a time.
+template <typename captype, typename tcaptype> class GridTileSource
+{
+public:
+	virtual ~GridTileSource() {}
+
+	// Fills the capacities of the w x h block of the grid whose top left node is (x0,y0).
+	// All arrays have w*h elements, in row-major order. For the node k of the block:
+	//   source[k], sink[k]       capacities of SOURCE->k and k->SINK
+	//   right[k], right_rev[k]   capacities of the arc from k to its right neighbour and back
+	//                            (ignored on the last column of the grid)
+	//   down[k], down_rev[k]     capacities of the arc from k to its lower neighbour and back
+	//                            (ignored on the last row of the grid)
+	virtual void read(int x0, int y0, int w, int h, tcaptype* source, tcaptype* sink,
+	                  captype* right, captype* right_rev, captype* down, captype* down_rev) = 0;
+};
+
+
+
+// captype, tcaptype, flowtype: as in GridGraph
+template <typename captype, typename tcaptype, typename flowtype> class TiledGridGraph
+{
+public:
+	typedef enum
+	{
+		SOURCE	= 0,
+		SINK	= 1
+	} termtype; // terminals
+
+	// Constructor.
+	// The width x height grid is cut in tile_size x tile_size tiles, which are paged
+	// to the file page_file_name (created, or overwritten; removed by the destructor).
+	// At most memory_budget bytes are used for the tiles in memory and the GridGraph
+	// solving a region; the budget must hold at least 4 tiles and this GridGraph.
+	// The last (optional) argument is the pointer to the function which will be called
+	// if an error occurs; an error message is passed to this function.
+	// If this argument is omitted, exit(1) will be called.
+	TiledGridGraph(int width, int height, int tile_size, size_t memory_budget,
+	               const char* page_file_name, void (*err_function)(const char *) = NULL);
+
+	// Destructor
+	~TiledGridGraph();
+
+	// smallest memory_budget accepted by the constructor for the given tile size
+	static size_t get_min_memory_budget(int tile_size)
+	{
+		return (size_t)tile_size*tile_size*(RegionGraph::get_node_size() + 4*sizeof(cell));
+	}
+
+	// Reads the capacities of the whole grid from 'source', tile by tile.
+	// Must be called once, before maxflow().
+	void build(GridTileSource<captype,tcaptype>* source);
+
+	// Maximum number of sweeps over the tiles and the shifted windows (default 4).
+	void set_sweep_num(int num) { sweep_num = (num > 0) ? num : 0; }
+
+	// Computes the maxflow. Must be called once.
+	flowtype maxflow();
+
+	// After the maxflow is computed, this function returns to which segment
+	// the node (x,y) belongs, as Graph::what_segment().
+	termtype what_segment(int x, int y, termtype default_segm = SOURCE);
+
+	int get_width() { return width; }
+	int get_height() { return height; }
+	int get_tile_size() { return tile_size; }
+
+	// statistics
+	int get_cache_tile_num() { return (int)slots.size(); } // number of tiles kept in memory
+	long long get_tile_reads() { return tile_reads; }      // tiles read from the page file
+	long long get_tile_writes() { return tile_writes; }    // tiles written to the page file
+	int get_path_num() { return path_num; }                 // paths augmented by the searches across tiles
+	int get_search_num() { return search_num; }             // searches from the source across tiles
+
+
+
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+/////////////////////////////////////////////////////////////////////////
+
+private:
+	typedef GridGraph<captype,tcaptype,flowtype> RegionGraph;
+
+	// state of a node, as stored in the page file
+	struct cell
+	{
+		tcaptype		tr_cap;		// as in Graph: SOURCE->node minus node->SINK residual capacity
+		captype			r_cap[4];	// residual capacities of the arcs leaving the node (directions of GridGraph)
+		unsigned char	label;		// labels of the searches of maxflow() (see tiledgraph.h)
+	};
+
+	// tiles in memory
+	struct slot
+	{
+		int					tile;		// -1 if unused
+		bool				dirty;		// must be written to the page file
+		long long			last_use;
+		std::vector<cell>	cells;		// tile_size*tile_size cells, row-major
+	};
+
+	int					width, height, tile_size;
+	int					tile_x_num, tile_y_num;
+	size_t				tile_bytes;
+
+	FILE				*page_file;
+	char				*page_file_name;
+	std::vector<char>	on_disk;	// tile has been written to the page file
+	std::vector<int>	slot_of;	// slot of each tile, -1 if not in memory
+	std::vector<int>	label_stamp;	// search for which the labels of each tile were cleared
+	std::vector<int>	source_num;	// nodes with tr_cap > 0 of each tile, -1 if not counted yet
+	std::vector<slot>	slots;
+	long long			use_counter;
+
+	void	(*error_function)(const char *);
+
+	flowtype			flow;
+	int					sweep_num;
+	bool				built;
+	long long			tile_reads, tile_writes;
+	int					path_num;
+	int					search_num;	// the current search is the search_num-th (0 before the first)
+
+	void error(const char* msg) { if (error_function) (*error_function)(msg); exit(1); }
+
+	// the cell of node (x,y), loading its tile if needed; 'write' marks the tile as modified
+	cell& at(int x, int y, bool write);
+	int load(int tile);
+	void flush(int s);
+
+	flowtype solve_window(int x0, int y0, int w, int h);
+	flowtype sweep(int offset);
+
+	bool search_source(); // returns true if a path was augmented
+	void search_sink();
+	bool augment(int x, int y); // returns true if the path had residual capacity
+};
+
+
+
+///////////////////////////////////////
+// Implementation                    //
+///////////////////////////////////////
+
+
+
+// labels of cells
+#define TILEDGRAPH_SOURCE_REACHED	1		/* reachable from the source */
+#define TILEDGRAPH_SINK_REACHED		2		/* the sink is reachable from it */
+#define TILEDGRAPH_PARENT_SHIFT		2		/* bits 2-4: 0 = no parent, 1 = source, 2+d = neighbour in direction d */
+#define TILEDGRAPH_PARENT_MASK		(7<<TILEDGRAPH_PARENT_SHIFT)
+#define TILEDGRAPH_SOURCE_EXPANDED	32		/* arcs scanned by the search from the source */
+#define TILEDGRAPH_SINK_EXPANDED	64		/* arcs scanned by the search to the sink */
+#define TILEDGRAPH_BLOCKED			128		/* its path from the source in the search was saturated by augment() */
+
+template <typename captype, typename tcaptype, typename flowtype>
+	TiledGridGraph<captype,tcaptype,flowtype>::TiledGridGraph(int _width, int _height, int _tile_size, size_t memory_budget,
+	                                                          const char* _page_file_name, void (*err_function)(const char *))
+	: width(_width),
+	  height(_height),
+	  tile_size(_tile_size),
+	  use_counter(0),
+	  error_function(err_function),
+	  flow(0),
+	  sweep_num(4),
+	  built(false),
+	  tile_reads(0),
+	  tile_writes(0),
+	  path_num(0),
+	  search_num(0)
+{
+	if (width < 1 || height < 1 || tile_size < 2) error("Invalid grid or tile size!");
+
+	tile_x_num = (width  + tile_size - 1) / tile_size;
+	tile_y_num = (height + tile_size - 1) / tile_size;
+	tile_bytes = (size_t)tile_size*tile_size*sizeof(cell);
+
+	size_t region_bytes = (size_t)tile_size*tile_size*RegionGraph::get_node_size();
+	if (memory_budget < get_min_memory_budget(tile_size)) error("Memory budget too small for the tile size!");
+	size_t slot_num = (memory_budget - region_bytes) / tile_bytes;
+	if (slot_num > (size_t)tile_x_num*tile_y_num) slot_num = (size_t)tile_x_num*tile_y_num;
+
+	page_file_name = new char[strlen(_page_file_name)+1];
+	strcpy(page_file_name, _page_file_name);
+	page_file = fopen(page_file_name, "w+b");
+	if (!page_file) error("Cannot create the page file!");
+
+	on_disk.assign(tile_x_num*tile_y_num, 0);
+	slot_of.assign(tile_x_num*tile_y_num, -1);
+	label_stamp.assign(tile_x_num*tile_y_num, 0);
+	slots.resize(slot_num);
+	for (size_t s=0; s<slot_num; s++)
+	{
+		slots[s].tile = -1;
+		slots[s].dirty = false;
+		slots[s].last_use = 0;
+	}
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	TiledGridGraph<captype,tcaptype,flowtype>::~TiledGridGraph()
+{
+	fclose(page_file);
+	remove(page_file_name);
+	delete [] page_file_name;
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void TiledGridGraph<captype,tcaptype,flowtype>::flush(int s)
+{
+	slot& S = slots[s];
+	if (S.tile >= 0 && S.dirty)
+	{
+		if (TILEDGRAPH_FSEEK(page_file, (tiledgraph_off_t)S.tile*tile_bytes, SEEK_SET) != 0
+		 || fwrite(&S.cells[0], sizeof(cell), S.cells.size(), page_file) != S.cells.size()) error("Cannot write the page file!");
+		on_disk[S.tile] = 1;
+		tile_writes ++;
+	}
+	S.dirty = false;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	int TiledGridGraph<captype,tcaptype,flowtype>::load(int tile)
+{
+	int s = slot_of[tile];
+	if (s < 0)
+	{
+		/* evict the least recently used tile */
+		int k;
+		s = 0;
+		for (k=1; k<(int)slots.size(); k++)
+		{
+			if (slots[k].last_use < slots[s].last_use) s = k;
+		}
+		slot& S = slots[s];
+		flush(s);
+		if (S.tile >= 0) slot_of[S.tile] = -1;
+		if (S.cells.empty()) S.cells.resize(tile_size*tile_size);
+
+		if (on_disk[tile])
+		{
+			if (TILEDGRAPH_FSEEK(page_file, (tiledgraph_off_t)tile*tile_bytes, SEEK_SET) != 0
+			 || fread(&S.cells[0], sizeof(cell), S.cells.size(), page_file) != S.cells.size()) error("Cannot read the page file!");
+			tile_reads ++;
+		}
+		else
+		{
+			memset(&S.cells[0], 0, tile_bytes);
+		}
+		S.tile = tile;
+		slot_of[tile] = s;
+	}
+	if (label_stamp[tile] != search_num)
+	{
+		/* labels of an earlier search */
+		slot& S = slots[s];
+		for (size_t k=0; k<S.cells.size(); k++) S.cells[k].label = 0;
+		S.dirty = true;
+		label_stamp[tile] = search_num;
+	}
+	slots[s].last_use = ++ use_counter;
+	return s;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	inline typename TiledGridGraph<captype,tcaptype,flowtype>::cell& TiledGridGraph<captype,tcaptype,flowtype>::at(int x, int y, bool write)
+{
+	int s = load((y/tile_size)*tile_x_num + x/tile_size);
+	if (write) slots[s].dirty = true;
+	return slots[s].cells[(y%tile_size)*tile_size + x%tile_size];
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	void TiledGridGraph<captype,tcaptype,flowtype>::build(GridTileSource<captype,tcaptype>* source)
+{
+	if (built) error("build() can be called only once!");
+	built = true;
+
+	std::vector<tcaptype> source_cap(tile_size*tile_size), sink_cap(tile_size*tile_size);
+	std::vector<captype> right(tile_size*tile_size), right_rev(tile_size*tile_size);
+	std::vector<captype> down(tile_size*tile_size), down_rev(tile_size*tile_size);
+	int tx, ty, x, y;
+
+	for (ty=0; ty<tile_y_num; ty++)
+	for (tx=0; tx<tile_x_num; tx++)
+	{
+		int x0 = tx*tile_size, y0 = ty*tile_size;
+		int w = (x0 + tile_size <= width)  ? tile_size : width  - x0;
+		int h = (y0 + tile_size <= height) ? tile_size : height - y0;
+
+		source -> read(x0, y0, w, h, &source_cap[0], &sink_cap[0], &right[0], &right_rev[0], &down[0], &down_rev[0]);
+
+		for (y=0; y<h; y++)
+		for (x=0; x<w; x++)
+		{
+			int k = y*w + x;
+			cell& c = at(x0+x, y0+y, true);
+
+			/* as Graph::add_tweights() */
+			tcaptype cap_source = source_cap[k], cap_sink = sink_cap[k];
+			flow += (cap_source < cap_sink) ? cap_source : cap_sink;
+			c.tr_cap = cap_source - cap_sink;
+
+			if (x0+x+1 < width)
+			{
+				assert(right[k] >= 0 && right_rev[k] >= 0);
+				c.r_cap[RegionGraph::RIGHT] = right[k];
+				at(x0+x+1, y0+y, true).r_cap[RegionGraph::LEFT] = right_rev[k];
+			}
+			if (y0+y+1 < height)
+			{
+				assert(down[k] >= 0 && down_rev[k] >= 0);
+				at(x0+x, y0+y, true).r_cap[RegionGraph::DOWN] = down[k];
+				at(x0+x, y0+y+1, true).r_cap[RegionGraph::UP] = down_rev[k];
+			}
+		}
+	}
+}
+
+/***********************************************************************/
+
+/*
+	Solves the window on the current residual graph, using only the arcs
+	inside it, and writes the residual capacities back. Returns the pushed flow,
+	which is the decrease of the source capacities (augmenting paths never
+	change the sign of tr_cap).
+*/
+template <typename captype, typename tcaptype, typename flowtype>
+	flowtype TiledGridGraph<captype,tcaptype,flowtype>::solve_window(int x0, int y0, int w, int h)
+{
+	RegionGraph* g = new RegionGraph(w, h, error_function);
+	flowtype pushed = 0;
+	int x, y, n;
+
+	g -> add_node(w*h);
+	for (y=0, n=0; y<h; y++)
+	for (x=0; x<w; x++, n++)
+	{
+		cell c = at(x0+x, y0+y, false); // (a copy: reading a neighbour may load another tile)
+		g -> add_tweights(n, (c.tr_cap > 0) ? c.tr_cap : 0, (c.tr_cap < 0) ? -c.tr_cap : 0);
+		if (x+1 < w) g -> add_edge(n, n+1, c.r_cap[RegionGraph::RIGHT], at(x0+x+1, y0+y, false).r_cap[RegionGraph::LEFT]);
+		if (y+1 < h) g -> add_edge(n, n+w, c.r_cap[RegionGraph::DOWN], at(x0+x, y0+y+1, false).r_cap[RegionGraph::UP]);
+	}
+
+	g -> maxflow();
+
+	for (y=0, n=0; y<h; y++)
+	for (x=0; x<w; x++, n++)
+	{
+		cell& c = at(x0+x, y0+y, true);
+		tcaptype t_old = c.tr_cap, t_new = g->get_trcap(n);
+		if (t_old > 0) pushed += t_old - ((t_new > 0) ? t_new : 0);
+		c.tr_cap = t_new;
+		if (x+1 < w) c.r_cap[RegionGraph::RIGHT] = g->get_rcap(n, RegionGraph::RIGHT);
+		if (y+1 < h) c.r_cap[RegionGraph::DOWN]  = g->get_rcap(n, RegionGraph::DOWN);
+		if (x > 0)   c.r_cap[RegionGraph::LEFT]  = g->get_rcap(n, RegionGraph::LEFT);
+		if (y > 0)   c.r_cap[RegionGraph::UP]    = g->get_rcap(n, RegionGraph::UP);
+	}
+
+	delete g;
+	return pushed;
+}
+
+// solves the windows of the size of a tile whose corners are shifted by 'offset' from the tiles
+template <typename captype, typename tcaptype, typename flowtype>
+	flowtype TiledGridGraph<captype,tcaptype,flowtype>::sweep(int offset)
+{
+	flowtype pushed = 0;
+	int x0, y0;
+
+	for (y0=-offset; y0<height; y0+=tile_size)
+	for (x0=-offset; x0<width; x0+=tile_size)
+	{
+		int xa = (x0 > 0) ? x0 : 0, ya = (y0 > 0) ? y0 : 0;
+		int xb = (x0 + tile_size < width)  ? x0 + tile_size : width;
+		int yb = (y0 + tile_size < height) ? y0 + tile_size : height;
+		if (xb > xa && yb > ya) pushed += solve_window(xa, ya, xb - xa, yb - ya);
+	}
+	return pushed;
+}
+
+/***********************************************************************/
+
+/*
+	Augments the path of the search from the source ending at (x,y),
+	a node connected to the sink. The paths augmented before by the same
+	search may have saturated an arc of this one; then nothing is done, and
+	the nodes of the path below that arc are blocked, so that the next paths
+	through them stop there.
+*/
+template <typename captype, typename tcaptype, typename flowtype>
+	bool TiledGridGraph<captype,tcaptype,flowtype>::augment(int x_end, int y_end)
+{
+	static const int dx[4] = { 1, 0, -1, 0 }, dy[4] = { 0, 1, 0, -1 };
+	tcaptype bottleneck = - at(x_end, y_end, false).tr_cap;
+	int x, y, p;
+
+	/* bottleneck */
+	for (x=x_end, y=y_end; ; )
+	{
+		cell& c = at(x, y, false);
+		if (c.label & TILEDGRAPH_BLOCKED) { bottleneck = 0; break; }
+		p = (c.label & TILEDGRAPH_PARENT_MASK) >> TILEDGRAPH_PARENT_SHIFT;
+		if (p == 1)
+		{
+			if (bottleneck > c.tr_cap) bottleneck = c.tr_cap;
+			break;
+		}
+		int d = p - 2;
+		captype r = at(x + dx[d], y + dy[d], false).r_cap[d^2];
+		if (bottleneck > r) bottleneck = r;
+		if (bottleneck <= 0) break;
+		x += dx[d]; y += dy[d];
+	}
+
+	if (bottleneck <= 0)
+	{
+		/* blocking the nodes from (x_end,y_end) to (x,y) */
+		int x_block = x, y_block = y;
+		for (x=x_end, y=y_end; ; )
+		{
+			cell& c = at(x, y, true);
+			c.label |= TILEDGRAPH_BLOCKED;
+			if (x == x_block && y == y_block) break;
+			int d = ((c.label & TILEDGRAPH_PARENT_MASK) >> TILEDGRAPH_PARENT_SHIFT) - 2;
+			x += dx[d]; y += dy[d];
+		}
+		return false;
+	}
+
+	/* augmenting */
+	at(x_end, y_end, true).tr_cap += bottleneck;
+	for (x=x_end, y=y_end; ; )
+	{
+		cell& c = at(x, y, true);
+		p = (c.label & TILEDGRAPH_PARENT_MASK) >> TILEDGRAPH_PARENT_SHIFT;
+		if (p == 1)
+		{
+			c.tr_cap -= bottleneck;
+			if (c.tr_cap <= 0) source_num[(y/tile_size)*tile_x_num + x/tile_size] --;
+			break;
+		}
+		int d = p - 2;
+		c.r_cap[d] += bottleneck;
+		x += dx[d]; y += dy[d];
+		at(x, y, true).r_cap[d^2] -= bottleneck;
+	}
+
+	flow += bottleneck;
+	path_num ++;
+	return true;
+}
+
+/*
+	Breadth-first search from the source over the residual arcs, tile by tile:
+	the nodes of a tile are expanded while the tile is in memory, and reaching a
+	node of another tile queues that tile. Every node connected to the sink
+	that is expanded ends a path, which is augmented. search_num must be
+	incremented before, so that load() clears the labels of the previous search.
+*/
+template <typename captype, typename tcaptype, typename flowtype>
+	bool TiledGridGraph<captype,tcaptype,flowtype>::search_source()
+{
+	static const int dx[4] = { 1, 0, -1, 0 }, dy[4] = { 0, 1, 0, -1 };
+	int tile_num = tile_x_num*tile_y_num;
+	std::vector<int> tile_queue;
+	std::vector<char> queued(tile_num, 0);
+	std::vector<int> queue;
+	bool augmented = false;
+	size_t q;
+	int t, k, d;
+
+	/* the tiles without nodes connected to the source are searched only if reached from other tiles */
+	for (t=0; t<tile_num; t++)
+	{
+		if (source_num[t] != 0) { queued[t] = 1; tile_queue.push_back(t); }
+	}
+
+	for (q=0; q<tile_queue.size(); q++)
+	{
+		t = tile_queue[q];
+		queued[t] = 0;
+		int x0 = (t % tile_x_num)*tile_size, y0 = (t / tile_x_num)*tile_size;
+		int w = (x0 + tile_size <= width)  ? tile_size : width  - x0;
+		int h = (y0 + tile_size <= height) ? tile_size : height - y0;
+
+		/* seeds: the nodes of the tile connected to the source, or reached from other tiles */
+		queue.clear();
+		source_num[t] = 0;
+		for (k=0; k<w*h; k++)
+		{
+			int x = x0 + k % w, y = y0 + k / w;
+			cell& c = at(x, y, true);
+			if (c.tr_cap > 0) source_num[t] ++;
+			if (c.label & TILEDGRAPH_SOURCE_EXPANDED) continue;
+			if (!(c.label & TILEDGRAPH_SOURCE_REACHED) && c.tr_cap > 0)
+			{
+				c.label |= TILEDGRAPH_SOURCE_REACHED | (1<<TILEDGRAPH_PARENT_SHIFT);
+			}
+			if (c.label & TILEDGRAPH_SOURCE_REACHED) queue.push_back(k);
+		}
+
+		for (size_t i=0; i<queue.size(); i++)
+		{
+			int x = x0 + queue[i] % w, y = y0 + queue[i] / w;
+			cell* c = &at(x, y, true);
+			c->label |= TILEDGRAPH_SOURCE_EXPANDED;
+			if (c->tr_cap < 0 && augment(x, y)) augmented = true;
+			for (d=0; d<4; d++)
+			{
+				int xn = x + dx[d], yn = y + dy[d];
+				if (xn < 0 || xn >= width || yn < 0 || yn >= height) continue;
+				c = &at(x, y, true); // (the previous neighbour may have evicted the tile)
+				if (c->r_cap[d] <= 0) continue;
+				cell& cn = at(xn, yn, true);
+				if (cn.label & TILEDGRAPH_SOURCE_REACHED) continue;
+				cn.label |= TILEDGRAPH_SOURCE_REACHED | ((2+(d^2))<<TILEDGRAPH_PARENT_SHIFT);
+				if (xn >= x0 && xn < x0 + w && yn >= y0 && yn < y0 + h) queue.push_back((yn-y0)*w + xn-x0);
+				else
+				{
+					int tn = (yn/tile_size)*tile_x_num + xn/tile_size;
+					if (!queued[tn]) { queued[tn] = 1; tile_queue.push_back(tn); }
+				}
+			}
+		}
+	}
+	return augmented;
+}
+
+// Labels the nodes from which the sink is reachable (same traversal as search_source(), backwards).
+template <typename captype, typename tcaptype, typename flowtype>
+	void TiledGridGraph<captype,tcaptype,flowtype>::search_sink()
+{
+	static const int dx[4] = { 1, 0, -1, 0 }, dy[4] = { 0, 1, 0, -1 };
+	int tile_num = tile_x_num*tile_y_num;
+	std::vector<int> tile_queue;
+	std::vector<char> queued(tile_num, 1);
+	std::vector<int> queue;
+	size_t q;
+	int t, k, d;
+
+	for (t=0; t<tile_num; t++) tile_queue.push_back(t);
+
+	for (q=0; q<tile_queue.size(); q++)
+	{
+		t = tile_queue[q];
+		queued[t] = 0;
+		int x0 = (t % tile_x_num)*tile_size, y0 = (t / tile_x_num)*tile_size;
+		int w = (x0 + tile_size <= width)  ? tile_size : width  - x0;
+		int h = (y0 + tile_size <= height) ? tile_size : height - y0;
+
+		queue.clear();
+		for (k=0; k<w*h; k++)
+		{
+			cell& c = at(x0 + k % w, y0 + k / w, true);
+			if (c.label & TILEDGRAPH_SINK_EXPANDED) continue;
+			if (c.tr_cap < 0) c.label |= TILEDGRAPH_SINK_REACHED;
+			if (c.label & TILEDGRAPH_SINK_REACHED) queue.push_back(k);
+		}
+
+		for (size_t i=0; i<queue.size(); i++)
+		{
+			int x = x0 + queue[i] % w, y = y0 + queue[i] / w;
+			at(x, y, true).label |= TILEDGRAPH_SINK_EXPANDED;
+			for (d=0; d<4; d++)
+			{
+				int xn = x + dx[d], yn = y + dy[d];
+				if (xn < 0 || xn >= width || yn < 0 || yn >= height) continue;
+				cell& cn = at(xn, yn, true);
+				if ((cn.label & TILEDGRAPH_SINK_REACHED) || cn.r_cap[d^2] <= 0) continue;
+				cn.label |= TILEDGRAPH_SINK_REACHED;
+				if (xn >= x0 && xn < x0 + w && yn >= y0 && yn < y0 + h) queue.push_back((yn-y0)*w + xn-x0);
+				else
+				{
+					int tn = (yn/tile_size)*tile_x_num + xn/tile_size;
+					if (!queued[tn]) { queued[tn] = 1; tile_queue.push_back(tn); }
+				}
+			}
+		}
+	}
+}
+
+/***********************************************************************/
+
+template <typename captype, typename tcaptype, typename flowtype>
+	flowtype TiledGridGraph<captype,tcaptype,flowtype>::maxflow()
+{
+	int s;
+
+	if (!built) error("build() must be called before maxflow()!");
+
+	for (s=0; s<sweep_num; s++)
+	{
+		flowtype pushed = sweep(0);
+		pushed += sweep(tile_size/2);
+		flow += pushed;
+		if (pushed == 0) break;
+	}
+
+	/* the paths across tiles */
+	source_num.assign(tile_x_num*tile_y_num, -1);
+	do search_num ++;
+	while (search_source());
+
+	search_sink();
+
+	return flow;
+}
+
+template <typename captype, typename tcaptype, typename flowtype>
+	typename TiledGridGraph<captype,tcaptype,flowtype>::termtype TiledGridGraph<captype,tcaptype,flowtype>::what_segment(int x, int y, termtype default_segm)
+{
+	assert(x >= 0 && x < width && y >= 0 && y < height);
+
+	unsigned char label = at(x, y, false).label;
+	if (label & TILEDGRAPH_SINK_REACHED)   return SINK;
+	if (label & TILEDGRAPH_SOURCE_REACHED) return SOURCE;
+	return default_segm;
+}
+
+
+#endif
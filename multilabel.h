@@ -0,0 +1,283 @@
+// Multi-label energy minimization on a 4-connected grid by alpha-expansion
+// and alpha-beta swap moves (Boykov, Veksler and Zabih, "Fast approximate
+// energy minimization via graph cuts", PAMI 2001), each move being a binary
+// graph cut.
+//
+// Pixel (r, c) is node r * cols + c, as in image_graph.h. One Graph is built
+// for the grid when the labeling is created, and every move only writes new
+// capacities in it: no node or arc is allocated again.
+
+#ifndef MULTILABEL_H
+#define MULTILABEL_H
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+#include "maxflow-v3.03.src/graph.h"
+#include "image_graph.h"
+
+// Labeling of a rows x cols grid with labels 0 .. label_num - 1 minimizing
+//     sum over pixels n of energy.data(n, l_n)
+//   + sum over 4-connected pixels m < n of energy.pairwise(m, n, l_m, l_n)
+// 'energy' must provide both functions, with values of type cost_t. For an
+// expansion move pairwise(m, n, ., .) must be a metric in the labels and for
+// a swap move a semimetric; otherwise the terms of a move that cannot be
+// represented in the graph are dropped, and a move is only accepted if it
+// lowers the energy.
+//
+// With 'reuse_trees', the capacities of a move are written with
+// edit_tweights() and edit_edge() (only those that differ from the previous
+// move) and the move is solved with maxflow(true), starting from the flow and
+// the search trees of the previous move. It pays for swap moves, which only
+// change the pixels of two labels; an expansion move changes the capacities
+// of nearly every pixel, and is solved faster from zero (the default).
+template <typename cost_t, typename GraphType, typename Energy>
+class grid_labeling
+{
+public:
+    grid_labeling(int rows, int cols, int label_num, const Energy &energy, bool reuse_trees = false)
+        : rows(rows), cols(cols), label_num(label_num), energy(energy), reuse_trees(reuse_trees),
+          labels(rows * cols, 0), solved(false)
+    {
+        g = new_grid_graph<GraphType>(rows, cols);
+        if ( reuse_trees )
+        {
+            g->track_capacities();
+            tweights.assign(2 * rows * cols, 0);
+            edge_caps.assign(2 * grid_edge_count(rows, cols), 0);
+        }
+        g->add_node(rows * cols);
+        for ( int n = 0; n < rows * cols; n++ )
+        {
+            if ( (n + 1) % cols ) g->add_edge( n, n + 1, 0, 0 );
+            if ( n + cols < rows * cols ) g->add_edge( n, n + cols, 0, 0 );
+        }
+        current_energy = compute_energy(labels);
+    }
+
+    ~grid_labeling()
+    {
+        delete g;
+    }
+
+    const std::vector<int> &get_labels() const { return labels; }
+
+    void set_labels(const std::vector<int> &l)
+    {
+        assert((int)l.size() == rows * cols);
+        labels = l;
+        current_energy = compute_energy(labels);
+    }
+
+    cost_t get_energy() const { return current_energy; }
+
+    cost_t compute_energy(const std::vector<int> &l) const
+    {
+        cost_t e = 0;
+        for ( int n = 0; n < rows * cols; n++ )
+        {
+            e += energy.data(n, l[n]);
+            if ( (n + 1) % cols ) e += energy.pairwise(n, n + 1, l[n], l[n + 1]);
+            if ( n + cols < rows * cols ) e += energy.pairwise(n, n + cols, l[n], l[n + cols]);
+        }
+        return e;
+    }
+
+    // Best labeling where every pixel keeps its label or takes 'alpha'.
+    // Returns true if the energy decreased.
+    bool expansion(int alpha)
+    {
+        return move(alpha, alpha);
+    }
+
+    // Best labeling where the pixels labelled 'alpha' or 'beta' take one of
+    // these two labels and the other pixels keep theirs. Returns true if the
+    // energy decreased.
+    bool swap(int alpha, int beta)
+    {
+        assert(alpha != beta);
+        return move(alpha, beta);
+    }
+
+    // Expansion moves on every label in turn, until a cycle over all labels
+    // does not lower the energy or after max_cycles cycles. Returns the
+    // number of cycles.
+    int expansion_cycles(int max_cycles = 100)
+    {
+        int cycle = 0;
+        bool decreased = true;
+        while ( decreased && cycle < max_cycles )
+        {
+            decreased = false;
+            for ( int alpha = 0; alpha < label_num; alpha++ )
+            {
+                if ( expansion(alpha) ) decreased = true;
+            }
+            cycle++;
+        }
+        return cycle;
+    }
+
+    // Same as expansion_cycles() with swap moves on every pair of labels.
+    int swap_cycles(int max_cycles = 100)
+    {
+        int cycle = 0;
+        bool decreased = true;
+        while ( decreased && cycle < max_cycles )
+        {
+            decreased = false;
+            for ( int alpha = 0; alpha < label_num; alpha++ )
+            {
+                for ( int beta = alpha + 1; beta < label_num; beta++ )
+                {
+                    if ( swap(alpha, beta) ) decreased = true;
+                }
+            }
+            cycle++;
+        }
+        return cycle;
+    }
+
+private:
+    const int rows, cols, label_num;
+    const Energy &energy;
+    const bool reuse_trees;
+    GraphType *g;
+    std::vector<int> labels;
+    cost_t current_energy;
+
+    // costs of the binary variable of every pixel being 0 and 1 during a move
+    std::vector<cost_t> cost0, cost1;
+    std::vector<int> proposal;
+
+    // capacities written by the previous move, with reuse_trees
+    std::vector<cost_t> tweights, edge_caps;
+    bool solved;
+
+    // Binary variable of pixel n: 0 keeps l_n (expansion) or takes alpha
+    // (swap), 1 takes alpha (expansion) or beta (swap); it is 1 if the node
+    // is in the SINK segment. alpha == beta for an expansion move.
+    bool in_move(int n, int alpha, int beta) const
+    {
+        return alpha == beta || labels[n] == alpha || labels[n] == beta;
+    }
+    int label0(int n, int alpha, int beta) const { return alpha == beta ? labels[n] : alpha; }
+    int label1(int n, int alpha, int beta) const { return beta; }
+
+    // Costs of the edge m-n for the binary variables of m and n, written
+    // from m to n as in "What energy functions can be minimized via graph
+    // cuts?" (Kolmogorov and Zabih, PAMI 2004): E(x_m, x_n) is
+    //     A + (C - A) x_m + (D - C) x_n + (B + C - A - D) (1 - x_m) x_n
+    // where the last term is the arc m->n. Pixels out of the move have a
+    // fixed label, and their terms go to the costs of the other pixel.
+    void add_pairwise(int m, int n, int alpha, int beta, cost_t &cap)
+    {
+        const bool move_m = in_move(m, alpha, beta);
+        const bool move_n = in_move(n, alpha, beta);
+        cap = 0;
+        if ( move_m && move_n )
+        {
+            const cost_t A = energy.pairwise(m, n, label0(m, alpha, beta), label0(n, alpha, beta));
+            const cost_t B = energy.pairwise(m, n, label0(m, alpha, beta), label1(n, alpha, beta));
+            const cost_t C = energy.pairwise(m, n, label1(m, alpha, beta), label0(n, alpha, beta));
+            const cost_t D = energy.pairwise(m, n, label1(m, alpha, beta), label1(n, alpha, beta));
+            cost0[m] += A;
+            cost1[m] += C;
+            cost1[n] += D - C;
+            cap = std::max(B + C - A - D, cost_t(0));
+        }
+        else if ( move_m )
+        {
+            cost0[m] += energy.pairwise(m, n, label0(m, alpha, beta), labels[n]);
+            cost1[m] += energy.pairwise(m, n, label1(m, alpha, beta), labels[n]);
+        }
+        else if ( move_n )
+        {
+            cost0[n] += energy.pairwise(m, n, labels[m], label0(n, alpha, beta));
+            cost1[n] += energy.pairwise(m, n, labels[m], label1(n, alpha, beta));
+        }
+    }
+
+    void write_edge(typename GraphType::arc_id a, int k, cost_t cap)
+    {
+        if ( !reuse_trees )
+        {
+            g->set_edge( a, cap, 0 );
+        }
+        else if ( edge_caps[k] != cap )
+        {
+            edge_caps[k] = cap;
+            g->edit_edge( a, cap, 0 );
+        }
+    }
+
+    bool move(int alpha, int beta)
+    {
+        const int N = rows * cols;
+        cost0.assign(N, 0);
+        cost1.assign(N, 0);
+
+        if ( !reuse_trees ) g->reset_capacities();
+
+        // n-links, in the order of the arcs
+        typename GraphType::arc_id a = g->get_first_arc();
+        int k = 0;
+        for ( int n = 0; n < N; n++ )
+        {
+            if ( in_move(n, alpha, beta) )
+            {
+                cost0[n] += energy.data(n, label0(n, alpha, beta));
+                cost1[n] += energy.data(n, label1(n, alpha, beta));
+            }
+            cost_t cap;
+            if ( (n + 1) % cols )
+            {
+                add_pairwise(n, n + 1, alpha, beta, cap);
+                write_edge(a, k++, cap);
+                a = g->get_next_arc(g->get_next_arc(a));
+            }
+            if ( n + cols < N )
+            {
+                add_pairwise(n, n + cols, alpha, beta, cap);
+                write_edge(a, k++, cap);
+                a = g->get_next_arc(g->get_next_arc(a));
+            }
+        }
+
+        // t-links: the cost of 1 is paid by cutting SOURCE->n, the cost of 0
+        // by cutting n->SINK; only their difference matters
+        for ( int n = 0; n < N; n++ )
+        {
+            const cost_t c = std::min(cost0[n], cost1[n]);
+            const cost_t source = cost1[n] - c;
+            const cost_t sink = cost0[n] - c;
+            if ( !reuse_trees )
+            {
+                g->add_tweights( n, source, sink );
+            }
+            else if ( tweights[2 * n] != source || tweights[2 * n + 1] != sink )
+            {
+                tweights[2 * n] = source;
+                tweights[2 * n + 1] = sink;
+                g->edit_tweights( n, source, sink );
+            }
+        }
+
+        g->maxflow(reuse_trees && solved);
+        solved = true;
+
+        proposal = labels;
+        for ( int n = 0; n < N; n++ )
+        {
+            if ( !in_move(n, alpha, beta) ) continue;
+            proposal[n] = g->what_segment(n) == GraphType::SINK ? label1(n, alpha, beta) : label0(n, alpha, beta);
+        }
+        const cost_t e = compute_energy(proposal);
+        if ( e >= current_energy ) return false;
+        labels.swap(proposal);
+        current_energy = e;
+        return true;
+    }
+};
+
+#endif
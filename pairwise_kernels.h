@@ -0,0 +1,224 @@
+// Capacities of the n-links of a 4-connected grid computed from an 8-bit
+// grayscale image a whole row at a time, for the usual contrast terms of
+// interactive segmentation:
+//     Potts                   lambda
+//     contrast-sensitive      lambda * exp(-beta * d^2)   (as in GrabCut)
+//     truncated linear        lambda * (truncation - min(d, truncation))
+// where d = |w_m - w_n| is the difference of the values of the two pixels.
+//
+// A kernel is the table of its capacity for the 256 values of d, so the
+// exponential is computed 256 times and not once per n-link. A row is the
+// absolute differences of two rows of pixels looked up in the table: with
+// AVX2 eight pixels at a time (a gather), and one by one otherwise. Only the
+// AVX2 version is vectorized; compile with -mavx2 (or the MAXFLOW_NATIVE
+// option of CMakeLists.txt) to get it.
+
+#ifndef PAIRWISE_KERNELS_H
+#define PAIRWISE_KERNELS_H
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <type_traits>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "maxflow-v3.03.src/graph.h"
+#include "maxflow-v3.03.src/gridgraph.h"
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+// weight[d]: capacity (in both directions) of the n-link between two pixels
+// whose values differ by d
+struct pairwise_kernel
+{
+    float weight[256];
+};
+
+inline pairwise_kernel potts_kernel(float lambda)
+{
+    pairwise_kernel k;
+    std::fill(k.weight, k.weight + 256, lambda);
+    return k;
+}
+
+inline pairwise_kernel contrast_kernel(float lambda, double beta)
+{
+    pairwise_kernel k;
+    for ( int d = 0; d < 256; d++ )
+    {
+        k.weight[d] = float(lambda * std::exp(-beta * d * d));
+    }
+    return k;
+}
+
+inline pairwise_kernel truncated_linear_kernel(float lambda, int truncation)
+{
+    pairwise_kernel k;
+    for ( int d = 0; d < 256; d++ )
+    {
+        k.weight[d] = lambda * (truncation - std::min(d, truncation));
+    }
+    return k;
+}
+
+// beta of GrabCut for contrast_kernel(): 1 / (2 <d^2>), the mean being over
+// the n-links of the 4-connected grid of 'image' (CV_8UC1). 0 for an image
+// without contrast, where every n-link then gets lambda.
+inline double contrast_beta(const cv::Mat &image)
+{
+    assert(image.type() == CV_8UC1);
+
+    const int rows = image.rows;
+    const int cols = image.cols;
+    double sum = 0;
+    for ( int r = 0; r < rows; r++ )
+    {
+        const unsigned char *row = image.ptr<unsigned char>(r);
+        const unsigned char *below = r + 1 < rows ? image.ptr<unsigned char>(r + 1) : 0;
+        long long row_sum = 0;
+        for ( int c = 0; c + 1 < cols; c++ )
+        {
+            const int d = row[c + 1] - row[c];
+            row_sum += d * d;
+        }
+        if ( below )
+        {
+            for ( int c = 0; c < cols; c++ )
+            {
+                const int d = below[c] - row[c];
+                row_sum += d * d;
+            }
+        }
+        sum += row_sum;
+    }
+    const int link_num = rows * (cols - 1) + (rows - 1) * cols;
+    return sum > 0 ? link_num / (2 * sum) : 0;
+}
+
+// out[c] = k.weight[|a[c] - b[c]|] for c = 0 .. num - 1: the n-links of a row
+// to its right neighbours (b = a + 1) or to the row below (b = next row).
+inline void pairwise_row(const unsigned char *a, const unsigned char *b, int num,
+                         const pairwise_kernel &k, float *out)
+{
+    int c = 0;
+#if defined(__AVX2__)
+    for ( ; c + 8 <= num; c += 8 )
+    {
+        const __m256i va = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(a + c)));
+        const __m256i vb = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(b + c)));
+        const __m256i d = _mm256_abs_epi32(_mm256_sub_epi32(va, vb));
+        _mm256_storeu_ps(out + c, _mm256_i32gather_ps(k.weight, d, 4));
+    }
+#endif
+    for ( ; c < num; c++ )
+    {
+        out[c] = k.weight[std::abs(a[c] - b[c])];
+    }
+}
+
+// The n-links of the grid of 'image' (CV_8UC1) as cost images for the cost
+// image version of build_grid_graph(): right_cost(r, c) links (r, c) and
+// (r, c + 1), down_cost(r, c) links (r, c) and (r + 1, c); both are CV_32F,
+// with 0 in the last column and the last row respectively.
+inline void grid_pairwise_costs(const cv::Mat &image, const pairwise_kernel &k,
+                                cv::Mat &right_cost, cv::Mat &down_cost)
+{
+    assert(image.type() == CV_8UC1);
+
+    const int rows = image.rows;
+    const int cols = image.cols;
+    right_cost.create(rows, cols, CV_32F);
+    down_cost.create(rows, cols, CV_32F);
+
+    for ( int r = 0; r < rows; r++ )
+    {
+        const unsigned char *row = image.ptr<unsigned char>(r);
+        float *right = right_cost.ptr<float>(r);
+        float *down = down_cost.ptr<float>(r);
+        pairwise_row(row, row + 1, cols - 1, k, right);
+        right[cols - 1] = 0;
+        if ( r + 1 < rows )
+        {
+            pairwise_row(row, image.ptr<unsigned char>(r + 1), cols, k, down);
+        }
+        else
+        {
+            std::fill(down, down + cols, 0.0f);
+        }
+    }
+}
+
+// Capacity types of the graphs build_grid_graph() below accepts.
+template <typename GraphType> struct kernel_graph_capacities;
+
+template <typename captype, typename tcaptype, typename flowtype, int layout, int schedule>
+struct kernel_graph_capacities< Graph<captype, tcaptype, flowtype, layout, schedule> >
+{
+    typedef captype cap_type;
+    typedef tcaptype tcap_type;
+};
+
+template <typename captype, typename tcaptype, typename flowtype>
+struct kernel_graph_capacities< GridGraph<captype, tcaptype, flowtype> >
+{
+    typedef captype cap_type;
+    typedef tcaptype tcap_type;
+};
+
+// Add the nodes, t-links and n-links of 'image' (CV_8UC1) to an empty graph,
+// in the order of the other versions of build_grid_graph(): the t-links of
+// 'energy' (source(w) and sink(w), as for build_grid_graph(g, image, energy),
+// tabulated for the 256 values of w) and the n-links of kernel 'k', computed
+// one row at a time. The capacities are floats, so the graph (a Graph or a
+// GridGraph) must have floating point capacities: an integer type would
+// truncate the weights of contrast_kernel() below 1 to 0.
+template <typename GraphType, typename Energy>
+void build_grid_graph(GraphType *g, const cv::Mat &image, const Energy &energy, const pairwise_kernel &k)
+{
+    static_assert(std::is_floating_point<typename kernel_graph_capacities<GraphType>::cap_type>::value
+                  && std::is_floating_point<typename kernel_graph_capacities<GraphType>::tcap_type>::value,
+                  "the capacities of a kernel need a graph of floating point capacities");
+    assert(image.type() == CV_8UC1);
+
+    const int rows = image.rows;
+    const int cols = image.cols;
+
+    float source_cost[256], sink_cost[256];
+    for ( int w = 0; w < 256; w++ )
+    {
+        source_cost[w] = float(energy.source((unsigned char)w));
+        sink_cost[w] = float(energy.sink((unsigned char)w));
+    }
+    std::vector<float> right(cols), down(cols);
+
+    typename GraphType::node_id n = g->add_node(rows * cols);
+
+    for ( int r = 0; r < rows; r++ )
+    {
+        const unsigned char *row = image.ptr<unsigned char>(r);
+        const bool has_below = r + 1 < rows;
+        pairwise_row(row, row + 1, cols - 1, k, &right[0]);
+        if ( has_below )
+        {
+            pairwise_row(row, image.ptr<unsigned char>(r + 1), cols, k, &down[0]);
+        }
+
+        for ( int c = 0; c < cols; c++, n++ )
+        {
+            g->add_tweights( n, source_cost[row[c]], sink_cost[row[c]] );
+
+            if ( c + 1 < cols )
+            {
+                g->add_edge( n, n + 1, right[c], right[c] );
+            }
+            if ( has_below )
+            {
+                g->add_edge( n, n + cols, down[c], down[c] );
+            }
+        }
+    }
+}
+
+#endif
@@ -17,6 +17,7 @@
 
 #include <iostream>
 #include "maxflow-v3.03.src/graph.h"
+#include "maxflow-v3.03.src/parallelgraph.h"
 
 // Test for the example in Figure 12.6 of Computer Vision: Models, Learning, and Inference.
 void test_Prince_figure_12_6()
@@ -141,6 +142,30 @@ double unary_term_sink(pixel_gray_level_t w_n, pixel_gray_level_t sink)
     return w_n == sink ? equality_cost : difference_cost;
 }
 
+// The energy of formula (12.12), in the form expected by build_grid_graph().
+struct denoising_energy
+{
+    denoising_energy(pixel_gray_level_t source_grey_value, pixel_gray_level_t sink_grey_value, double theta_10, double theta_01)
+        : source_grey_value(source_grey_value), sink_grey_value(sink_grey_value), theta_10(theta_10), theta_01(theta_01) {}
+
+    double source(pixel_gray_level_t w_n) const
+    {
+        return unary_term_source(w_n, source_grey_value);
+    }
+    double sink(pixel_gray_level_t w_n) const
+    {
+        return unary_term_sink(w_n, sink_grey_value);
+    }
+    double pairwise(pixel_gray_level_t w_m, pixel_gray_level_t w_n) const
+    {
+        return pairwise_term(w_m, w_n, theta_10, theta_01);
+    }
+
+    pixel_gray_level_t source_grey_value, sink_grey_value;
+    double theta_10, theta_01;
+};
+
+#include <algorithm>
 #include <random>
 #include <vector>
 
@@ -186,12 +211,40 @@ void SampleWithoutReplacement
 
 
 
+// Check that Deque keeps its items in order when it grows with items
+// wrapped around the end of its ring.
+void test_deque()
+{
+    Deque<int> deque(4);
+    std::vector<int> expected;
+    for ( int k = 0; k < 100; k++ )
+    {
+        // after the first pops, the front of the ring is not at its start
+        if ( k % 3 == 0 ) { deque.PushFront(k); expected.insert(expected.begin(), k); }
+        else              { deque.PushBack(k); expected.push_back(k); }
+        if ( k % 5 == 4 )
+        {
+            const int front = deque.PopFront();
+            assert(front == expected.front());
+            expected.erase(expected.begin());
+        }
+    }
+    for ( size_t k = 0; k < expected.size(); k++ )
+    {
+        assert(!deque.IsEmpty());
+        const int front = deque.PopFront();
+        assert(front == expected[k]);
+    }
+    assert(deque.IsEmpty());
+}
+
 #include <limits>
 
 void test()
 {
 
     test_Prince_figure_12_6();
+    test_deque();
 
     assert(std::numeric_limits<index_1D>::is_integer);
     assert(std::numeric_limits<index_1D>::is_signed);
@@ -226,6 +279,8 @@ void test()
 #include <opencv2/core/core.hpp>
 #include <opencv2/highgui/highgui.hpp>
 #include <opencv2/imgproc/imgproc.hpp>
+#include "image_graph.h"
+#include "tiled_image.h"
 
 void corrupt( const cv::Mat input, cv::Mat &output, double percentage )
 {
@@ -244,13 +299,1101 @@ void corrupt( const cv::Mat input, cv::Mat &output, double percentage )
     }
 }
 
-int main(int argc, char **argv)
+// Image of the tests: a rows x cols black image with a white rectangle,
+// rows r0 .. r1 - 1 and columns c0 .. c1 - 1, with 20% of its pixels flipped.
+cv::Mat make_corrupted_square( int rows, int cols, int r0, int r1, int c0, int c1 )
+{
+    cv::Mat image(rows, cols, CV_8UC1, cv::Scalar(0));
+    for ( int r = r0; r < r1; r++ )
+    {
+        for ( int c = c0; c < c1; c++ )
+        {
+            image.at<pixel_gray_level_t>(r, c) = 255;
+        }
+    }
+    cv::Mat corrupted;
+    corrupt(image, corrupted, 0.2);
+    return corrupted;
+}
+
+#include <cstdlib>
+#include <unistd.h>
+
+// Name of a new empty scratch file of the tests, unique to this run, in TMPDIR
+// (or /tmp): runs started together, or from a directory that cannot be
+// written, do not share their files. The caller removes it.
+std::string make_scratch_file()
+{
+    const char *dir = getenv("TMPDIR");
+    std::string name = std::string(dir && *dir ? dir : "/tmp") + "/binary_graph_cuts_XXXXXX";
+    std::vector<char> buffer(name.begin(), name.end());
+    buffer.push_back(0);
+    const int fd = mkstemp(&buffer[0]);
+    if ( fd < 0 )
+    {
+        std::cerr << "Could not create a scratch file like " << name << "\n";
+        exit(1);
+    }
+    close(fd);
+    return std::string(&buffer[0]);
+}
+
+// Check that the bulk exports of the segmentation of a solved rows x cols
+// grid graph agree with what_segment(), node by node.
+void test_export_segmentation( Graph<double, double, double> *g, int rows, int cols )
+{
+    typedef Graph<double, double, double> GraphType;
+    const index_1D N = rows * cols;
+
+    std::vector< unsigned char > bytes(N, 1);
+    g->export_segmentation(&bytes[0], 10, 20);
+    std::vector< unsigned char > bits((N + 7) / 8), inverted_bits((N + 7) / 8);
+    g->export_segmentation_bits(&bits[0]);
+    g->export_segmentation_bits(&inverted_bits[0], GraphType::SOURCE);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        const bool sink = g->what_segment(n) == GraphType::SINK;
+        assert(bytes[n] == (sink ? 20 : 10));
+        assert(((bits[n / 8] >> (n % 8)) & 1) == (sink ? 1 : 0));
+        assert(((inverted_bits[n / 8] >> (n % 8)) & 1) == (sink ? 0 : 1));
+    }
+
+    // a range in the middle leaves the rest of the buffer alone
+    std::vector< unsigned char > range(N, 1);
+    g->export_segmentation(&range[cols], 10, 20, GraphType::SOURCE, cols, cols + 3);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        assert(range[n] == ((n >= cols && n < 2 * cols + 3) ? bytes[n] : 1));
+    }
+
+    // and bands of rows written by several threads make the same image
+    cv::Mat one_band, bands;
+    export_grid_segmentation(g, rows, cols, one_band, 10, 20);
+    export_grid_segmentation(g, rows, cols, bands, 10, 20, 3);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        const index_2D p = map_1D_to_2D(n, cols);
+        assert(one_band.at<pixel_gray_level_t>(p.r, p.c) == bytes[n]);
+        assert(bands.at<pixel_gray_level_t>(p.r, p.c) == bytes[n]);
+    }
+}
+
+// Check that a graph with the given layout and schedule gives the same flow
+// and segmentation as 'reference', a graph with the pointer layout solved
+// with maximum flow 'flow'.
+template <int layout, int schedule>
+void test_grid_builder_layout( const cv::Mat &corrupted, const denoising_energy &energy, double flow, Graph<double, double, double> *reference )
+{
+    typedef Graph<double, double, double, layout, schedule> GraphType;
+    GraphType *g = new_grid_graph<GraphType>(corrupted.rows, corrupted.cols);
+    build_grid_graph<pixel_gray_level_t>(g, corrupted, energy);
+    const double g_flow = g->maxflow();
+    assert(g_flow == flow);
+    for ( index_1D n = 0; n < g->get_node_num(); n++ )
+    {
+        assert((int)g->what_segment(n) == (int)reference->what_segment(n));
+    }
+    delete g;
+}
+
+// Check that build_grid_graph() gives the same segmentation as the search
+// for 4-connected pairs with need_edge(), and the same flow with GridGraph.
+void test_grid_builder()
+{
+    typedef Graph<double, double, double> GraphType;
+
+    const int rows = 7;
+    const int cols = 9;
+    cv::Mat corrupted = make_corrupted_square(rows, cols, 2, 5, 3, 8);
+
+    const denoising_energy energy(0, 255, 1, 1);
+
+    GraphType *g = new_grid_graph<GraphType>(rows, cols);
+    build_grid_graph<pixel_gray_level_t>(g, corrupted, energy);
+    assert(g->get_arc_num() == 2 * grid_edge_count(rows, cols));
+    double flow = g->maxflow();
+
+    const index_1D N = rows * cols;
+    GraphType *h = new GraphType(N, 4 * N);
+    h->add_node(N);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        index_2D p_n = map_1D_to_2D(n, cols);
+        pixel_gray_level_t w_n = corrupted.at<pixel_gray_level_t>(p_n.r, p_n.c);
+        h->add_tweights( n, energy.source(w_n), energy.sink(w_n) );
+        for ( index_1D m = 0; m < n; m++ )
+        {
+            if ( need_edge(m, n, cols) )
+            {
+                index_2D p_m = map_1D_to_2D(m, cols);
+                pixel_gray_level_t w_m = corrupted.at<pixel_gray_level_t>(p_m.r, p_m.c);
+                h->add_edge( m, n, energy.pairwise(w_m, w_n), energy.pairwise(w_n, w_m) );
+            }
+        }
+    }
+    const double h_flow = h->maxflow();
+    assert(flow == h_flow);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        assert(g->what_segment(n) == h->what_segment(n));
+    }
+    test_export_segmentation(g, rows, cols);
+
+    typedef GridGraph<double, double, double> GridGraphType;
+    GridGraphType *gg = new_grid_graph<GridGraphType>(rows, cols);
+    build_grid_graph<pixel_gray_level_t>(gg, corrupted, energy);
+    const double gg_flow = gg->maxflow();
+    assert(flow == gg_flow);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        // the source trees are the nodes reachable from the source, whichever the maximum flow
+        assert((gg->what_segment(n, GridGraphType::SINK) == GridGraphType::SOURCE) == (g->what_segment(n, GraphType::SINK) == GraphType::SOURCE));
+    }
+
+    // reordering the arcs by origin does not change the cut...
+    GraphType *fg = new_grid_graph<GraphType>(rows, cols);
+    build_grid_graph<pixel_gray_level_t>(fg, corrupted, energy);
+    assert(fg->arcs_in_add_order());
+    fg->finalize();
+    assert(!fg->arcs_in_add_order()); // refill_grid_graph() no longer applies
+    const double fg_flow = fg->maxflow();
+    assert(fg_flow == flow);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        assert(fg->what_segment(n) == g->what_segment(n));
+    }
+    delete fg;
+
+    // and neither does moving the nodes along a Morton curve
+    GraphType *mg = new_grid_graph<GraphType>(rows, cols);
+    build_grid_graph<pixel_gray_level_t>(mg, corrupted, energy);
+    std::vector< int > order;
+    grid_morton_order(rows, cols, order);
+    mg->reorder_nodes(&order[0]);
+    const double mg_flow = mg->maxflow();
+    assert(mg_flow == flow);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        assert(mg->what_segment(n) == g->what_segment(n));
+    }
+    test_export_segmentation(mg, rows, cols);
+    delete mg;
+
+    // the other maxflow algorithms find a maximum flow too, and the same segmentation
+    const GraphType::algotype algorithms[] = { GraphType::HPF, GraphType::IBFS };
+    for ( int k = 0; k < 2; k++ )
+    {
+        GraphType *ag = new_grid_graph<GraphType>(rows, cols);
+        build_grid_graph<pixel_gray_level_t>(ag, corrupted, energy);
+        ag->set_algorithm(algorithms[k]);
+        const double ag_flow = ag->maxflow();
+        assert(ag_flow == flow);
+        for ( index_1D n = 0; n < N; n++ )
+        {
+            assert(ag->what_segment(n) == g->what_segment(n));
+            assert(ag->what_segment(n, GraphType::SINK) == g->what_segment(n, GraphType::SINK));
+        }
+        delete ag;
+    }
+
+    // the other layouts run the same algorithm on the same arcs
+    test_grid_builder_layout<GRAPH_INDICES, GRAPH_FIFO>(corrupted, energy, flow, g);
+    test_grid_builder_layout<GRAPH_INDICES_SPLIT, GRAPH_FIFO>(corrupted, energy, flow, g);
+
+    // and the other schedules grow the trees in another order, to the same cut
+    test_grid_builder_layout<GRAPH_INDICES, GRAPH_LIFO>(corrupted, energy, flow, g);
+    test_grid_builder_layout<GRAPH_INDICES, GRAPH_DISTANCE>(corrupted, energy, flow, g);
+    test_grid_builder_layout<GRAPH_INDICES, GRAPH_ALTERNATE>(corrupted, energy, flow, g);
+
+    // the out-of-core solver finds the same cut, with tiles paged to disk
+    typedef TiledGridGraph<double, double, double> TiledGraphType;
+    const int tile_size = 4;
+    const std::string page_name = make_scratch_file(); // removed by tg
+    TiledGraphType tg(cols, rows, tile_size, TiledGraphType::get_min_memory_budget(tile_size), page_name.c_str());
+    mat_tile_reader reader(corrupted);
+    energy_tile_source<double, double, denoising_energy> source(reader, energy);
+    tg.build(&source);
+    const double tg_flow = tg.maxflow();
+    assert(tg_flow == flow);
+    assert(tg.get_cache_tile_num() == 4);
+    for ( index_1D n = 0; n < N; n++ )
+    {
+        const index_2D p = map_1D_to_2D(n, cols);
+        assert((int)tg.what_segment(p.c, p.r) == (int)g->what_segment(n));
+    }
+
+    // the parallel solver finds the same cut, whichever the strips
+    typedef ParallelGraph<double, double, double> ParallelGraphType;
+    for ( int strips = 1; strips <= 4; strips++ )
+    {
+        ParallelGraphType *pg = new_grid_graph<ParallelGraphType>(rows, cols);
+        build_grid_graph<pixel_gray_level_t>(pg, corrupted, energy);
+        pg->set_grid_strips(cols, rows, strips);
+        pg->set_thread_num(2);
+        const double pg_flow = pg->maxflow();
+        assert(pg_flow == flow);
+        for ( index_1D n = 0; n < N; n++ )
+        {
+            assert(pg->what_segment(n) == g->what_segment(n));
+        }
+        delete pg;
+    }
+
+    delete g;
+    delete h;
+    delete gg;
+}
+
+// Check that editing the capacities of a few pixels and solving again with
+// the search trees of the previous solve gives the flow and the segmentation
+// of a graph built from scratch.
+template <typename GraphType>
+void test_dynamic_resolve()
+{
+
+    const int rows = 8;
+    const int cols = 10;
+    cv::Mat corrupted = make_corrupted_square(rows, cols, 2, 6, 2, 7);
+
+    const denoising_energy energy(0, 255, 1, 1);
+
+    GraphType *g = new_grid_graph<GraphType>(rows, cols);
+    g->track_capacities();
+    build_grid_graph<pixel_gray_level_t>(g, corrupted, energy);
+    g->maxflow();
+
+    Block<typename GraphType::node_id> *changed_list = new Block<typename GraphType::node_id>(16);
+    for ( int iter = 0; iter < 4; iter++ )
+    {
+        // flip a few pixels, and update their t-links and the n-links around them
+        std::vector< index_1D > flipped( 3 );
+        SampleWithoutReplacement(rows * cols, flipped.size(), flipped);
+        for ( size_t k = 0; k < flipped.size(); k++ )
+        {
+            const index_2D p = map_1D_to_2D(flipped[k], cols);
+            pixel_gray_level_t &w_n = corrupted.at<pixel_gray_level_t>(p.r, p.c);
+            w_n = w_n ? 0 : 255;
+            g->edit_tweights( flipped[k], energy.source(w_n), energy.sink(w_n) );
+        }
+        for ( typename GraphType::arc_id a = g->get_first_arc(); a < g->get_first_arc() + g->get_arc_num(); a = g->get_next_arc(g->get_next_arc(a)) )
+        {
+            typename GraphType::node_id m, n;
+            g->get_arc_ends(a, m, n);
+            const index_2D p_m = map_1D_to_2D(m, cols);
+            const index_2D p_n = map_1D_to_2D(n, cols);
+            const pixel_gray_level_t w_m = corrupted.at<pixel_gray_level_t>(p_m.r, p_m.c);
+            const pixel_gray_level_t w_n = corrupted.at<pixel_gray_level_t>(p_n.r, p_n.c);
+            if ( std::find(flipped.begin(), flipped.end(), m) != flipped.end() || std::find(flipped.begin(), flipped.end(), n) != flipped.end() )
+            {
+                g->edit_edge( a, energy.pairwise(w_m, w_n), energy.pairwise(w_n, w_m) );
+            }
+        }
+        const double flow = g->maxflow(true, changed_list);
+
+        GraphType *h = new_grid_graph<GraphType>(rows, cols);
+        build_grid_graph<pixel_gray_level_t>(h, corrupted, energy);
+        const double h_flow = h->maxflow();
+        assert(flow == h_flow);
+        for ( index_1D n = 0; n < rows * cols; n++ )
+        {
+            assert(g->what_segment(n) == h->what_segment(n));
+        }
+        delete h;
+
+        for ( typename GraphType::node_id *n = changed_list->ScanFirst(); n; n = changed_list->ScanNext() )
+        {
+            g->remove_from_changed_list(*n);
+        }
+        changed_list->Reset();
+    }
+
+    delete changed_list;
+    delete g;
+}
+
+// Check that a graph saved to a file and loaded into another graph gives the
+// same flow and segmentation, whether it was saved before or after maxflow(),
+// and that the capacities of track_capacities() and the node order of
+// reorder_nodes() (with the arcs it reordered) are kept.
+template <int layout>
+void test_graph_file()
+{
+    typedef Graph<double, double, double, layout> GraphType;
+
+    const int rows = 8;
+    const int cols = 10;
+    cv::Mat corrupted = make_corrupted_square(rows, cols, 3, 7, 1, 6);
+    const denoising_energy energy(0, 255, 1, 1);
+    const std::string scratch = make_scratch_file();
+    const char *file_name = scratch.c_str();
+
+    GraphType *g = new_grid_graph<GraphType>(rows, cols);
+    g->track_capacities();
+    build_grid_graph<pixel_gray_level_t>(g, corrupted, energy);
+    std::vector< int > order;
+    grid_morton_order(rows, cols, order);
+    g->reorder_nodes(&order[0]);
+    g->save(file_name);
+    const double flow = g->maxflow();
+
+    // a graph with room for fewer nodes and arcs grows to those of the file
+    GraphType *h = new GraphType(1, 1);
+    h->load(file_name);
+    assert(h->get_node_num() == rows * cols && h->get_arc_num() == g->get_arc_num());
+    assert(!h->arcs_in_add_order());
+    const double h_flow = h->maxflow();
+    assert(h_flow == flow);
+    for ( index_1D n = 0; n < rows * cols; n++ )
+    {
+        assert(h->what_segment(n) == g->what_segment(n));
+    }
+
+    // flipping a pixel of the loaded graph and solving again with its trees
+    // gives the cut of the same edit on the original graph
+    const index_1D flipped = 2 * cols + 4;
+    g->edit_tweights( flipped, 1, 0 );
+    h->edit_tweights( flipped, 1, 0 );
+    const double edited_flow = g->maxflow(true);
+    const double h_edited_flow = h->maxflow(true);
+    assert(h_edited_flow == edited_flow);
+    for ( index_1D n = 0; n < rows * cols; n++ )
+    {
+        assert(h->what_segment(n) == g->what_segment(n));
+    }
+
+    // saved after maxflow(), the residual graph keeps its flow
+    g->save(file_name);
+    h->load(file_name);
+    const double saved_flow = g->maxflow();
+    const double h_saved_flow = h->maxflow();
+    assert(h_saved_flow == saved_flow);
+    for ( index_1D n = 0; n < rows * cols; n++ )
+    {
+        assert(h->what_segment(n) == g->what_segment(n));
+    }
+
+    remove(file_name);
+    delete g;
+    delete h;
+}
+
+// Check that a maxflow() resumed from its last checkpoint, in another graph,
+// returns the same flow and segmentation as the call that wrote it, and that
+// load() reads a checkpoint as a graph to solve again.
+template <int layout, int schedule>
+void test_checkpoint()
+{
+    typedef Graph<double, double, double, layout, schedule> GraphType;
+
+    const int rows = 60;
+    const int cols = 60;
+    cv::Mat corrupted = make_corrupted_square(rows, cols, 10, 40, 20, 50);
+    const std::string scratch = make_scratch_file();
+    const char *file_name = scratch.c_str();
+
+    // a checkpoint every CHECKPOINT_STEPS growth steps
+    GraphType *g = new_grid_graph<GraphType>(rows, cols);
+    build_grid_graph<pixel_gray_level_t>(g, corrupted, denoising_energy(0, 255, 1, 1));
+    g->set_checkpoint(file_name, 0);
+    const double flow = g->maxflow();
+
+    GraphType *h = new GraphType(1, 1);
+    const double resumed_flow = h->resume(file_name);
+    assert(resumed_flow == flow);
+    for ( index_1D n = 0; n < rows * cols; n++ )
+    {
+        assert(h->what_segment(n) == g->what_segment(n));
+    }
+    h->load(file_name);
+    const double h_flow = h->maxflow();
+    assert(h_flow == flow);
+
+    remove(file_name);
+    delete g;
+    delete h;
+}
+
+// The denoising energy with its t-links and its n-links multiplied by two
+// factors, for test_compact_grid_graph().
+struct scaled_denoising_energy
+{
+    scaled_denoising_energy(double unary_scale, double pairwise_scale)
+        : energy(0, 255, 1, 1), unary_scale(unary_scale), pairwise_scale(pairwise_scale) {}
+
+    double source(pixel_gray_level_t w_n) const { return unary_scale * energy.source(w_n); }
+    double sink(pixel_gray_level_t w_n) const { return unary_scale * energy.sink(w_n); }
+    double pairwise(pixel_gray_level_t w_m, pixel_gray_level_t w_n) const { return pairwise_scale * energy.pairwise(w_m, w_n); }
+
+    denoising_energy energy;
+    double unary_scale, pairwise_scale;
+};
+
+// Solver of test_compact_grid_graph(): the flow and the segment of every node.
+struct segmentation_solver
+{
+    template <typename GraphType>
+    void operator()(GraphType *g)
+    {
+        flow = g->maxflow();
+        segments.resize(g->get_node_num());
+        for ( int n = 0; n < g->get_node_num(); n++ )
+        {
+            segments[n] = g->what_segment(n) == GraphType::SOURCE;
+        }
+    }
+
+    double flow;
+    std::vector<bool> segments;
+};
+
+// solve_compact_grid_graph() picks the narrowest capacity type that holds
+// the energy, and gets the flow and the cut of a Graph<double, double, double>.
+void test_compact_grid_graph()
+{
+    typedef Graph<double, double, double> GraphType;
+
+    const int rows = 60;
+    const int cols = 60;
+    cv::Mat corrupted = make_corrupted_square(rows, cols, 10, 40, 20, 50);
+
+    const struct
+    {
+        double unary_scale, pairwise_scale;
+        grid_capacity_type type;
+    } cases[] =
+    {
+        { 1, 1, GRID_CAPACITY_UINT8 },          // the energy of main()
+        { 100, 127, GRID_CAPACITY_UINT8 },      // n-links of 2 * 127 in both directions
+        { 100, 128, GRID_CAPACITY_INT16 },
+        { 40000, 1, GRID_CAPACITY_INT16 },      // t-links beyond a short
+        { 100, 20000, GRID_CAPACITY_INT32 },
+        { 1000000, 1, GRID_CAPACITY_DOUBLE },   // 3600 pixels of 1000000 overflow the flow
+        { 1, 0.5, GRID_CAPACITY_DOUBLE },
+    };
+    for ( size_t k = 0; k < sizeof(cases) / sizeof(cases[0]); k++ )
+    {
+        const scaled_denoising_energy energy(cases[k].unary_scale, cases[k].pairwise_scale);
+        assert(select_grid_capacity_type(corrupted, energy) == cases[k].type);
+
+        segmentation_solver solver;
+        const grid_capacity_type solved_type = solve_compact_grid_graph(corrupted, energy, solver);
+        assert(solved_type == cases[k].type);
+
+        GraphType *g = new_grid_graph<GraphType>(rows, cols);
+        build_grid_graph<pixel_gray_level_t>(g, corrupted, energy);
+        const double flow = g->maxflow();
+        assert(solver.flow == flow);
+        for ( index_1D n = 0; n < rows * cols; n++ )
+        {
+            assert(solver.segments[n] == (g->what_segment(n) == GraphType::SOURCE));
+        }
+        delete g;
+    }
+}
+
+// fix_persistent_nodes() fixes the pixels whose t-links outweigh their
+// n-links, and maxflow() then finds the flow and the cut it finds alone, with
+// BK and with HPF.
+template <typename GraphType>
+void test_persistent_nodes()
+{
+    const int rows = 60;
+    const int cols = 60;
+    cv::Mat corrupted = make_corrupted_square(rows, cols, 10, 40, 20, 50);
+
+    for ( int unary_scale = 1; unary_scale <= 3; unary_scale++ )
+    {
+        const scaled_denoising_energy energy(unary_scale, 1);
+        GraphType *g = new_grid_graph<GraphType>(rows, cols);
+        build_grid_graph<pixel_gray_level_t>(g, corrupted, energy);
+        const double flow = g->maxflow();
+
+        for ( int algorithm = GraphType::BK; algorithm <= GraphType::HPF; algorithm++ )
+        {
+            GraphType *h = new_grid_graph<GraphType>(rows, cols);
+            build_grid_graph<pixel_gray_level_t>(h, corrupted, energy);
+            h->set_algorithm((typename GraphType::algotype)algorithm);
+            const int fixed_num = h->fix_persistent_nodes();
+            assert(fixed_num > 0);
+            const double h_flow = h->maxflow();
+            assert(h_flow == flow);
+            for ( index_1D n = 0; n < rows * cols; n++ )
+            {
+                assert(h->what_segment(n) == g->what_segment(n));
+            }
+            delete h;
+        }
+        delete g;
+    }
+}
+
+// 200 leaves of a star send 255 each to its centre, whose sink t-link is 100:
+// HPF gathers 51000 at the centre, more than a short t-link holds, and sends
+// the surplus back to the leaves. All algorithms find a flow of 100.
+template <typename GraphType>
+void test_hpf_excess()
+{
+    const int leaves = 200;
+
+    for ( int algorithm = GraphType::BK; algorithm <= GraphType::IBFS; algorithm++ )
+    {
+        GraphType *g = new GraphType(leaves + 1, leaves);
+        g->add_node(leaves + 1);
+        g->add_tweights(leaves, 0, 100);
+        for ( int n = 0; n < leaves; n++ )
+        {
+            g->add_tweights(n, 255, 0);
+            g->add_edge(n, leaves, 255, 0);
+        }
+        g->set_algorithm((typename GraphType::algotype)algorithm);
+        const double flow = g->maxflow();
+        assert(flow == 100);
+        for ( int n = 0; n <= leaves; n++ )
+        {
+            assert(g->what_segment(n) == GraphType::SOURCE);
+        }
+        delete g;
+    }
+}
+
+#include "multilabel.h"
+
+// Energy of test_multilabel(): data costs drawn at random, and a truncated
+// linear smoothness term (a metric).
+struct random_multilabel_energy
+{
+    random_multilabel_energy( int pixel_num, int label_num ) : label_num(label_num), costs(pixel_num * label_num)
+    {
+        for ( size_t k = 0; k < costs.size(); k++ )
+        {
+            costs[k] = (int)(20 * GetUniform());
+        }
+    }
+
+    int data( int n, int l ) const
+    {
+        return costs[n * label_num + l];
+    }
+
+    int pairwise( int m, int n, int l_m, int l_n ) const
+    {
+        return 4 * std::min(std::abs(l_m - l_n), 2);
+    }
+
+    int label_num;
+    std::vector<int> costs;
+};
+
+// Check that every expansion and swap move of grid_labeling gives the
+// labeling of lowest energy among those the move can reach (found by
+// enumeration on a small grid), with and without reuse_trees.
+void test_multilabel()
+{
+    typedef Graph<int, int, int> GraphType;
+    typedef grid_labeling<int, GraphType, random_multilabel_energy> labeling_type;
+
+    const int rows = 3;
+    const int cols = 4;
+    const int N = rows * cols;
+    const int label_num = 4;
+    const random_multilabel_energy energy(N, label_num);
+
+    for ( int reuse_trees = 0; reuse_trees < 2; reuse_trees++ )
+    {
+        labeling_type labeling(rows, cols, label_num, energy, reuse_trees != 0);
+        std::vector<int> labels(N);
+        for ( int n = 0; n < N; n++ )
+        {
+            labels[n] = (int)(label_num * GetUniform()) % label_num;
+        }
+        labeling.set_labels(labels);
+
+        for ( int iter = 0; iter < 3 * label_num; iter++ )
+        {
+            const int alpha = iter % label_num;
+            const int beta = (alpha + 1 + iter / label_num) % label_num;
+            const bool swap = iter % 2 != 0;
+
+            // enumeration of the labelings reachable by the move
+            const std::vector<int> before = labeling.get_labels();
+            int best = labeling.get_energy();
+            for ( int x = 0; x < (1 << N); x++ )
+            {
+                std::vector<int> l = before;
+                for ( int n = 0; n < N; n++ )
+                {
+                    if ( swap && l[n] != alpha && l[n] != beta ) continue;
+                    if ( swap ) l[n] = (x >> n) & 1 ? beta : alpha;
+                    else if ( (x >> n) & 1 ) l[n] = alpha;
+                }
+                best = std::min(best, labeling.compute_energy(l));
+            }
+
+            const bool decreased = swap ? labeling.swap(alpha, beta) : labeling.expansion(alpha);
+            assert(labeling.get_energy() == best);
+            const int labels_energy = labeling.compute_energy(labeling.get_labels());
+            assert(labeling.get_energy() == labels_energy);
+            assert(decreased == (labeling.get_labels() != before));
+        }
+
+        const int energy_before_cycles = labeling.get_energy();
+        labeling.expansion_cycles();
+        assert(labeling.get_energy() <= energy_before_cycles);
+        for ( int alpha = 0; alpha < label_num; alpha++ )
+        {
+            const bool decreased = labeling.expansion(alpha);
+            assert(!decreased);
+        }
+    }
+}
+
+#include "pairwise_kernels.h"
+
+// Energy of test_pairwise_kernels(): the t-links of the denoising energy and
+// the n-links of a kernel, one pixel pair at a time.
+struct kernel_energy
+{
+    kernel_energy(const pairwise_kernel &k) : unary(0, 255, 1, 1), k(k) {}
+
+    double source(pixel_gray_level_t w_n) const { return unary.source(w_n); }
+    double sink(pixel_gray_level_t w_n) const { return unary.sink(w_n); }
+    double pairwise(pixel_gray_level_t w_m, pixel_gray_level_t w_n) const
+    {
+        return k.weight[std::abs(w_m - w_n)];
+    }
+
+    denoising_energy unary;
+    const pairwise_kernel &k;
+};
+
+// Check the kernels of pairwise_kernels.h against their formulas, and that
+// the graph built from their rows is the one built one n-link at a time. The
+// width is not a multiple of the SIMD widths, so the rows have scalar tails.
+void test_pairwise_kernels()
+{
+    typedef Graph<double, double, double> GraphType;
+
+    const int rows = 6;
+    const int cols = 37;
+    cv::Mat image(rows, cols, CV_8UC1);
+    srand(2024);
+    double d2_sum = 0;
+    for ( int r = 0; r < rows; r++ )
+    {
+        for ( int c = 0; c < cols; c++ )
+        {
+            image.at<pixel_gray_level_t>(r, c) = (r + c) % 3 ? 0 : rand() % 256;
+        }
+    }
+    for ( int r = 0; r < rows; r++ )
+    {
+        for ( int c = 0; c < cols; c++ )
+        {
+            const int w = image.at<pixel_gray_level_t>(r, c);
+            if ( c + 1 < cols ) d2_sum += (w - image.at<pixel_gray_level_t>(r, c + 1)) * (w - image.at<pixel_gray_level_t>(r, c + 1));
+            if ( r + 1 < rows ) d2_sum += (w - image.at<pixel_gray_level_t>(r + 1, c)) * (w - image.at<pixel_gray_level_t>(r + 1, c));
+        }
+    }
+    const double beta = contrast_beta(image);
+    assert(std::fabs(beta - grid_edge_count(rows, cols) / (2 * d2_sum)) < 1e-12);
+
+    const pairwise_kernel kernels[] = { potts_kernel(2), contrast_kernel(5, beta), truncated_linear_kernel(0.5, 40) };
+    assert(kernels[0].weight[0] == 2 && kernels[0].weight[255] == 2);
+    assert(kernels[1].weight[0] == 5 && kernels[1].weight[10] == float(5 * std::exp(-beta * 100)));
+    assert(kernels[2].weight[0] == 20 && kernels[2].weight[30] == 5 && kernels[2].weight[40] == 0 && kernels[2].weight[200] == 0);
+
+    for ( int k = 0; k < 3; k++ )
+    {
+        std::vector< float > right(cols - 1);
+        const pixel_gray_level_t *row = image.ptr<pixel_gray_level_t>(2);
+        pairwise_row(row, row + 1, cols - 1, kernels[k], &right[0]);
+        for ( int c = 0; c + 1 < cols; c++ )
+        {
+            assert(right[c] == kernels[k].weight[std::abs(row[c] - row[c + 1])]);
+        }
+
+        const kernel_energy energy(kernels[k]);
+        GraphType *g = new_grid_graph<GraphType>(rows, cols);
+        build_grid_graph(g, image, energy, kernels[k]);
+        GraphType *h = new_grid_graph<GraphType>(rows, cols);
+        build_grid_graph<pixel_gray_level_t>(h, image, energy);
+
+        // the cost images give the same graph too
+        cv::Mat source_cost(rows, cols, CV_32F), sink_cost(rows, cols, CV_32F), right_cost, down_cost;
+        for ( int r = 0; r < rows; r++ )
+        {
+            for ( int c = 0; c < cols; c++ )
+            {
+                source_cost.at<float>(r, c) = energy.source(image.at<pixel_gray_level_t>(r, c));
+                sink_cost.at<float>(r, c) = energy.sink(image.at<pixel_gray_level_t>(r, c));
+            }
+        }
+        grid_pairwise_costs(image, kernels[k], right_cost, down_cost);
+        GraphType *ch = new_grid_graph<GraphType>(rows, cols);
+        build_grid_graph<float>(ch, source_cost, sink_cost, right_cost, down_cost);
+
+        assert(g->get_arc_num() == h->get_arc_num() && g->get_arc_num() == ch->get_arc_num());
+        GraphType::arc_id a = g->get_first_arc(), b = h->get_first_arc(), e = ch->get_first_arc();
+        for ( int m = 0; m < g->get_arc_num(); m++ )
+        {
+            GraphType::node_id i, j, hi, hj;
+            g->get_arc_ends(a, i, j);
+            h->get_arc_ends(b, hi, hj);
+            assert(i == hi && j == hj);
+            assert(g->get_rcap(a) == h->get_rcap(b) && g->get_rcap(a) == ch->get_rcap(e));
+            a = g->get_next_arc(a);
+            b = h->get_next_arc(b);
+            e = ch->get_next_arc(e);
+        }
+        for ( index_1D n = 0; n < rows * cols; n++ )
+        {
+            assert(g->get_trcap(n) == h->get_trcap(n) && g->get_trcap(n) == ch->get_trcap(n));
+        }
+        const double flow = g->maxflow();
+        const double h_flow = h->maxflow();
+        const double ch_flow = ch->maxflow();
+        assert(flow == h_flow && flow == ch_flow);
+        for ( index_1D n = 0; n < rows * cols; n++ )
+        {
+            assert(g->what_segment(n) == h->what_segment(n));
+        }
+        delete g;
+        delete h;
+        delete ch;
+    }
+}
+
+#include "dimacs.h"
+
+// Check read_dimacs() on a small problem whose terminals are not the last
+// ids, with an arc from the source to the sink and one out of the sink, and
+// a round trip through write_dimacs() of a grid graph, before and after it
+// is solved.
+void test_dimacs()
+{
+    typedef Graph<double, double, double> GraphType;
+    const std::string scratch = make_scratch_file();
+    const char *file_name = scratch.c_str();
+
+    FILE *file = fopen(file_name, "wb");
+    fputs("c maximum flow 6 through the nodes, plus 2 from s to t\n"
+          "p max 6 10\n"
+          "n 3 s\n"
+          "n 1 t\n"
+          "a 3 2 4\na 3 4 3\na 2 4 2\na 2 5 3\na 4 5 1\n"
+          "a 4 6 2\na 5 1 4\na 6 1 3\na 3 1 2\n"
+          "a 1 2 5", file);
+    fclose(file);
+    dimacs_graph<GraphType> d;
+    bool read = read_dimacs<double>(file_name, d);
+    assert(read);
+    assert(d.source == 3 && d.sink == 1 && d.node_num == 6 && d.arc_num == 10);
+    assert(d.g->get_node_num() == 4 && d.node_of_id[2] == 0 && d.node_of_id[6] == 3);
+    const double flow = d.g->maxflow();
+    assert(flow == 8);
+    assert(dimacs_cut_value<double>(file_name, d) == 8);
+    delete d.g;
+
+    file = fopen(file_name, "wb");
+    fputs("p max 4 1\nn 1 s\nn 2 t\nx 1 2 3\n", file);
+    fclose(file);
+    long long error_line;
+    read = read_dimacs<double>(file_name, d, &error_line);
+    assert(!read && error_line == 4 && !d.g);
+
+    file = fopen(file_name, "wb");
+    fputs("p max 4 2\nn 1 s\nn 2 t\na 3 4 -5\na 1 3 2\n", file);
+    fclose(file);
+    read = read_dimacs<double>(file_name, d, &error_line);
+    assert(!read && error_line == 4 && !d.g);
+
+    const int rows = 6;
+    const int cols = 8;
+    cv::Mat corrupted = make_corrupted_square(rows, cols, 1, 4, 2, 7);
+    GraphType *g = new_grid_graph<GraphType>(rows, cols);
+    build_grid_graph<pixel_gray_level_t>(g, corrupted, denoising_energy(0, 255, 1, 1));
+    for ( int solved = 0; solved < 2; solved++ )
+    {
+        // the problem of the file has the maximum flow of g, solved or not
+        const bool written = write_dimacs<double>(g, file_name);
+        assert(written);
+        read = read_dimacs<double>(file_name, d);
+        assert(read);
+        assert(d.g->get_node_num() == rows * cols && d.node_of_id[1] == 0);
+        const double file_flow = d.g->maxflow();
+        assert(dimacs_cut_value<double>(file_name, d) == file_flow);
+        const double g_flow = solved ? g->get_flow() : g->maxflow();
+        assert(file_flow == g_flow);
+        delete d.g;
+    }
+    delete g;
+    remove(file_name);
+}
+
+// Denoise a binary PGM image too large for memory, as main() does (without
+// corruption), with TiledGridGraph. The arguments are
+//     --tiled input.pgm output.pgm [tile_size [memory_budget_in_MB]]
+int denoise_tiled(int argc, char **argv)
+{
+    const std::string input_name(argv[2]);
+    const std::string output_name(argv[3]);
+    const int tile_size = argc > 4 ? atoi(argv[4]) : 512;
+    const size_t budget = (argc > 5 ? atoi(argv[5]) : 256) * (size_t)1024 * 1024;
+
+    pgm_tile_reader pgm(input_name);
+    if ( !pgm.is_open() )
+    {
+        std::cout << "Could not open or read the binary PGM image '" << input_name << "'\n";
+        return -1;
+    }
+    threshold_tile_reader image(pgm, 128);
+
+    typedef TiledGridGraph<double, double, double> GraphType;
+    if ( tile_size < 2 || budget < GraphType::get_min_memory_budget(tile_size) )
+    {
+        std::cout << "The memory budget is too small for tiles of " << tile_size << " x " << tile_size << " pixels\n";
+        return -1;
+    }
+
+    const pixel_gray_level_t source_grey_value = 0;
+    const pixel_gray_level_t sink_grey_value = 255;
+    const denoising_energy energy(source_grey_value, sink_grey_value, 1, 1);
+    energy_tile_source<double, double, denoising_energy> source(image, energy);
+
+    GraphType g(image.cols(), image.rows(), tile_size, budget, (output_name + ".page").c_str());
+    g.build(&source);
+    double flow = g.maxflow();
+
+    std::cout << "flow " << flow << ", " << g.get_tile_reads() << " tiles read and "
+              << g.get_tile_writes() << " written, " << g.get_path_num() << " paths across tiles\n";
+
+    // same values as the denoised_ image of main()
+    if ( !save_tiled_segmentation(g, output_name, 255, 0) )
+    {
+        std::cout << "Could not write the image '" << output_name << "'\n";
+        return -1;
+    }
+    return 0;
+}
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// Names of the images of a batch: the files of 'path' if it is a directory,
+// otherwise the lines of the file 'path'. Return false if 'path' cannot be read.
+bool list_batch_images( const std::string &path, std::vector< std::string > &names )
+{
+    struct stat info;
+    if ( stat(path.c_str(), &info) != 0 ) return false;
+
+    if ( S_ISDIR(info.st_mode) )
+    {
+        DIR *dir = opendir(path.c_str());
+        if ( !dir ) return false;
+        while ( dirent *entry = readdir(dir) )
+        {
+            const std::string name = path + "/" + entry->d_name;
+            if ( stat(name.c_str(), &info) == 0 && S_ISREG(info.st_mode) )
+            {
+                names.push_back(name);
+            }
+        }
+        closedir(dir);
+        std::sort(names.begin(), names.end());
+        return true;
+    }
+
+    std::ifstream list(path.c_str());
+    if ( !list ) return false;
+    std::string name;
+    while ( std::getline(list, name) )
+    {
+        if ( !name.empty() ) names.push_back(name);
+    }
+    return true;
+}
+
+// Denoise many images, as main() does (without corruption), on several
+// threads. Each thread keeps one Graph for all its images and empties it
+// with reset(), so that its memory is allocated once; if an image has the
+// size of the previous one, only the capacities are written again, with
+// refill_grid_graph(). The arguments are
+//     --batch input_directory_or_list output_directory [thread_num]
+// and the result for image 'name' is output_directory/denoised_name.
+int denoise_batch(int argc, char **argv)
+{
+    std::vector< std::string > names;
+    if ( !list_batch_images(argv[2], names) )
+    {
+        std::cout << "Could not read the directory or the list of images '" << argv[2] << "'\n";
+        return -1;
+    }
+    const std::string output_dir(argv[3]);
+    int thread_num = argc > 4 ? atoi(argv[4]) : (int)std::thread::hardware_concurrency();
+    if ( thread_num < 1 ) thread_num = 1;
+
+    const pixel_gray_level_t source_grey_value = 0;
+    const pixel_gray_level_t sink_grey_value = 255;
+    const denoising_energy energy(source_grey_value, sink_grey_value, 1, 1);
+
+    typedef Graph<double, double, double> GraphType;
+    typedef std::chrono::steady_clock clock_type;
+
+    std::atomic<int> next_image(0);
+    std::atomic<int> failed(0);
+    std::atomic<long long> pixel_num(0);
+    std::mutex output_mutex;
+
+    const clock_type::time_point start = clock_type::now();
+
+    std::vector< std::thread > threads;
+    for ( int t = 0; t < thread_num; t++ )
+    {
+        threads.push_back(std::thread([&]()
+        {
+            GraphType *g = 0;
+            int rows = 0; // of the grid in g
+            for ( int k; (k = next_image++) < (int)names.size(); )
+            {
+                const clock_type::time_point image_start = clock_type::now();
+
+                cv::Mat image = cv::imread(names[k], CV_LOAD_IMAGE_GRAYSCALE);
+                if ( !image.data )
+                {
+                    failed++;
+                    std::lock_guard<std::mutex> lock(output_mutex);
+                    std::cout << "Could not open or find the image '" << names[k] << "'\n";
+                    continue;
+                }
+                cv::threshold(image, image, 128, 255, cv::THRESH_BINARY);
+
+                if ( g && g->get_node_num() == image.rows * image.cols && rows == image.rows )
+                {
+                    // same size as the previous image: same nodes and arcs
+                    refill_grid_graph<pixel_gray_level_t>(g, image, energy);
+                }
+                else
+                {
+                    if ( g ) g->reset();
+                    else     g = new_grid_graph<GraphType>(image.rows, image.cols);
+                    build_grid_graph<pixel_gray_level_t>(g, image, energy);
+                    rows = image.rows;
+                }
+                const double flow = g->maxflow();
+
+                // same values as the denoised_ image of main()
+                cv::Mat result;
+                export_grid_segmentation(g, image.rows, image.cols, result, 255, 0);
+                const std::string base_name = names[k].substr(names[k].find_last_of('/') + 1);
+                const bool written = cv::imwrite(output_dir + "/denoised_" + base_name, result);
+                if ( !written ) failed++;
+                pixel_num += (long long)image.rows * image.cols;
+
+                const double seconds = std::chrono::duration<double>(clock_type::now() - image_start).count();
+                std::lock_guard<std::mutex> lock(output_mutex);
+                std::cout << names[k] << ": " << image.cols << " x " << image.rows << ", flow " << flow << ", "
+                          << seconds * 1000 << " ms, " << image.rows * image.cols / seconds / 1e6 << " Mpixel/s"
+                          << (written ? "" : ", could not write the result") << "\n";
+            }
+            delete g;
+        }));
+    }
+    for ( int t = 0; t < thread_num; t++ )
+    {
+        threads[t].join();
+    }
+
+    const double seconds = std::chrono::duration<double>(clock_type::now() - start).count();
+    std::cout << names.size() << " images (" << failed << " failed) on " << thread_num << " threads in " << seconds << " s: "
+              << names.size() / seconds << " images/s, " << pixel_num / seconds / 1e6 << " Mpixel/s\n";
+    return failed ? -1 : 0;
+}
+
+// Solver of main() for solve_compact_grid_graph(): the flow and the
+// segmentation of a rows x cols image, in the grey values of the terminals
+// (result) and in the opposite ones (flipped).
+struct denoising_solver
+{
+    denoising_solver(int rows, int cols, pixel_gray_level_t source_grey_value, pixel_gray_level_t sink_grey_value)
+        : rows(rows), cols(cols), source_grey_value(source_grey_value), sink_grey_value(sink_grey_value), flow(0) {}
+
+    template <typename GraphType>
+    void operator()(GraphType *g)
+    {
+        flow = g -> maxflow();
+
+#ifdef MAXFLOW_STATS
+        const typename GraphType::maxflow_stats &stats = g->get_stats();
+        std::cerr << "maxflow: " << stats.growth_steps << " growth steps, " << stats.augmentations << " augmentations (mean length "
+                  << (stats.augmentations ? double(stats.path_length) / stats.augmentations : 0) << ", max " << stats.max_path_length << "), "
+                  << stats.orphans << " orphans (origin walks of " << stats.origin_walk << " arcs), "
+                  << stats.orphan_pushes << " orphan queue pushes (queue of " << stats.orphan_queue_size << " items)\n"
+                  << "maxflow: init " << stats.init_time << " s, growth " << stats.growth_time << " s, augmentation "
+                  << stats.augment_time << " s, adoption " << stats.adoption_time << " s\n";
+#endif
+
+        // one band of rows per hardware thread
+        const int export_threads = (int)std::thread::hardware_concurrency();
+        export_grid_segmentation(g, rows, cols, result, source_grey_value, sink_grey_value, export_threads);
+        export_grid_segmentation(g, rows, cols, flipped, source_grey_value ? 0 : 255, sink_grey_value ? 0 : 255, export_threads);
+    }
+
+    int rows, cols;
+    pixel_gray_level_t source_grey_value, sink_grey_value;
+    double flow;
+    cv::Mat result, flipped;
+};
+
+// binary_graph_cuts --self-test (the test of CMakeLists.txt): runs the tests
+// of this file, which the denoising runs skip.
+int self_test()
 {
     test();
+    test_grid_builder();
+    test_dynamic_resolve< Graph<double, double, double> >();
+    test_dynamic_resolve< Graph<unsigned char, short, int, GRAPH_INDICES> >();
+    test_graph_file<GRAPH_POINTERS>();
+    test_graph_file<GRAPH_INDICES_SPLIT>();
+    test_checkpoint<GRAPH_POINTERS, GRAPH_FIFO>();
+    test_checkpoint<GRAPH_INDICES_SPLIT, GRAPH_FIFO>();
+    test_checkpoint<GRAPH_INDICES, GRAPH_DISTANCE>();
+    test_compact_grid_graph();
+    test_persistent_nodes< Graph<double, double, double> >();
+    test_persistent_nodes< Graph<unsigned char, short, int, GRAPH_INDICES> >();
+    test_hpf_excess< Graph<unsigned char, short, int, GRAPH_INDICES> >();
+    test_multilabel();
+    test_pairwise_kernels();
+    test_dimacs();
+    std::cout << "All tests passed\n";
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    if ( argc == 2 && std::string(argv[1]) == "--self-test" )
+    {
+        return self_test();
+    }
+    if ( argc >= 4 && std::string(argv[1]) == "--tiled" )
+    {
+        return denoise_tiled(argc, argv);
+    }
+    if ( argc >= 4 && std::string(argv[1]) == "--batch" )
+    {
+        return denoise_batch(argc, argv);
+    }
 
     if ( argc < 2)
     {
         std::cout << " Usage: " << argv[0] << " image_to_process" << "\n";
+        std::cout << "        " << argv[0] << " --tiled input.pgm output.pgm [tile_size [memory_budget_in_MB]]" << "\n";
+        std::cout << "        " << argv[0] << " --batch input_directory_or_list output_directory [thread_num]" << "\n";
+        std::cout << "        " << argv[0] << " --self-test" << "\n";
         return -1;
     }
 
@@ -285,9 +1428,6 @@ int main(int argc, char **argv)
     }
     cv::imwrite("corrupted.png", corrupted);
 
-    const index_1D N = image.rows * image.cols;
-    const index_1D ncols = image.cols;
-
     const double theta_10 = 1;
     const double theta_01 = 1;
 
@@ -296,70 +1436,17 @@ int main(int argc, char **argv)
 
     //std::cout << "source=" << (int)source_grey_value << " sink=" << (int)sink_grey_value << "\n\n";
 
-    typedef Graph<double, double, double> GraphType;
-    // Initialize graph to empty
-    GraphType *g = new GraphType(N, 4 * N);
-
-    // Add all the nodes in one instruction
-    g->add_node(N);
-
-    for ( index_1D n = 0; n < N; n++ )
-    {
-        index_2D p_n = map_1D_to_2D(n, ncols);
-        pixel_gray_level_t w_n = corrupted.at<pixel_gray_level_t>(p_n.r, p_n.c);
-
-        // Create edges from source and to sink and set capacity to zero
-        pixel_gray_level_t unary_source = unary_term_source(w_n, source_grey_value);
-        pixel_gray_level_t unary_sink = unary_term_sink(w_n, sink_grey_value);
-        g->add_tweights( n, unary_source, unary_sink );
-
-        //std::cout << "n=" << n << " 2D=" << p_n << " v=" << (int)w_n << " c_source=" << (int)unary_source << " c_sink=" << (int)unary_sink << "\n";
-
-        // If edge between m and n is desired
-        for ( index_1D m = 0; m < n; m++ )
-        {
-            if ( need_edge(m, n, ncols) )
-            {
-                index_2D p_m = map_1D_to_2D(m, ncols);
-                pixel_gray_level_t w_m = corrupted.at<pixel_gray_level_t>(p_m.r, p_m.c);
-
-                double c_mn = pairwise_term(w_m, w_n, theta_10, theta_01);
-                double c_nm = pairwise_term(w_n, w_m, theta_10, theta_01);
-
-                g->add_edge(m, n, c_mn, c_nm);
-                //std::cout << "\t2D_m=" << p_m << " v=" << (int)w_m << " 2D_n=" << p_n << " v=" << (int)w_n << " c_mn=" << c_mn << " c_nm=" << c_nm << "\n";
-            }
-        }
-    }
-
     std::cerr << "\n\nWARNING: REPARAMETERIZATION NOT EXECUTED.\n\n";
 
-    double flow = g -> maxflow();
+    // Build the graph in the narrowest capacity type that holds the energy
+    // (adding the nodes, the t-links and the n-links in one pass over the
+    // image), solve it and read the segmentation in both polarities
+    denoising_solver solver(image.rows, image.cols, source_grey_value, sink_grey_value);
+    solve_compact_grid_graph(corrupted, denoising_energy(source_grey_value, sink_grey_value, theta_10, theta_01), solver);
 
-    cv::Mat result = corrupted.clone();
-    for ( index_1D n = 0; n < N; n++ )
-    {
-        const index_2D p = map_1D_to_2D(n, ncols);
-        if (g->what_segment(n) == GraphType::SOURCE)
-        {
-            result.at<pixel_gray_level_t>(p.r, p.c) = source_grey_value;
-        }
-        else if (g->what_segment(n) == GraphType::SINK)
-        {
-            result.at<pixel_gray_level_t>(p.r, p.c) = sink_grey_value;
-        }
-    }
-
-    cv::imwrite("result.png", result);
-
-    cv::Mat flipped = result.clone();
-    for ( index_1D n = 0; n < N; n++ )
-    {
-        const index_2D p = map_1D_to_2D(n, ncols);
-        flipped.at<pixel_gray_level_t>(p.r, p.c) = result.at<pixel_gray_level_t>(p.r, p.c) ? 0 : 255;
-    }
+    cv::imwrite("result.png", solver.result);
 
-    cv::imwrite(std::string("denoised_")+image_name, flipped);
+    cv::imwrite(std::string("denoised_")+image_name, solver.flipped);
 
     std::string opencv_working_version = "2.4.4";
     std::string current_opencv_version = CV_VERSION;
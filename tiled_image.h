@@ -0,0 +1,239 @@
+// Tiled access to 8-bit grey level images, and their segmentation with
+// TiledGridGraph, for images that do not fit in memory.
+//
+// A tile_reader gives the pixels of an image a block at a time;
+// energy_tile_source turns them into the capacities of formula (12.12) for
+// TiledGridGraph, as build_grid_graph() of image_graph.h does for a cv::Mat.
+
+#ifndef TILED_IMAGE_H
+#define TILED_IMAGE_H
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include "maxflow-v3.03.src/tiledgraph.h"
+
+// Reader of an 8-bit grey level image, a block of pixels at a time.
+class tile_reader
+{
+public:
+    virtual ~tile_reader() {}
+
+    virtual int rows() const = 0;
+    virtual int cols() const = 0;
+
+    // Copy the h x w block whose top left pixel is (r0, c0) to 'pixels', row by row.
+    virtual void read( int r0, int c0, int h, int w, unsigned char *pixels ) = 0;
+};
+
+// Reader of a binary (P5) PGM file with 8-bit pixels. Only the rows of the
+// requested block are read from the file.
+class pgm_tile_reader : public tile_reader
+{
+public:
+    explicit pgm_tile_reader( const std::string &file_name ) : file(0), nrows(0), ncols(0), data_offset(0)
+    {
+        file = fopen(file_name.c_str(), "rb");
+        if ( !file ) return;
+
+        char magic[3] = { 0, 0, 0 };
+        int maxval = 0;
+        if ( fread(magic, 1, 2, file) != 2 || strcmp(magic, "P5") != 0
+             || !read_header_int(ncols) || !read_header_int(nrows) || !read_header_int(maxval)
+             || ncols <= 0 || nrows <= 0 || maxval <= 0 || maxval > 255 )
+        {
+            fclose(file);
+            file = 0;
+            return;
+        }
+        // (read_header_int() consumed the single whitespace character before the pixels)
+        data_offset = ftell(file);
+    }
+
+    ~pgm_tile_reader()
+    {
+        if ( file ) fclose(file);
+    }
+
+    bool is_open() const { return file != 0; }
+
+    int rows() const { return nrows; }
+    int cols() const { return ncols; }
+
+    void read( int r0, int c0, int h, int w, unsigned char *pixels )
+    {
+        for ( int r = 0; r < h; r++ )
+        {
+            const tiledgraph_off_t offset = data_offset + (tiledgraph_off_t)(r0 + r) * ncols + c0;
+            if ( TILEDGRAPH_FSEEK(file, offset, SEEK_SET) != 0 || fread(pixels + r * w, 1, w, file) != (size_t)w )
+            {
+                memset(pixels + r * w, 0, w);
+            }
+        }
+    }
+
+private:
+    // Read a decimal number of the header, skipping whitespace and comments
+    // before it, and the character after it.
+    bool read_header_int( int &value )
+    {
+        int c = fgetc(file);
+        while ( c == '#' || c == ' ' || c == '\t' || c == '\r' || c == '\n' )
+        {
+            if ( c == '#' )
+            {
+                while ( c != '\n' && c != EOF ) c = fgetc(file);
+            }
+            c = fgetc(file);
+        }
+        if ( c < '0' || c > '9' ) return false;
+        value = 0;
+        while ( c >= '0' && c <= '9' )
+        {
+            value = value * 10 + (c - '0');
+            c = fgetc(file);
+        }
+        return true;
+    }
+
+    FILE *file;
+    int nrows, ncols;
+    long data_offset;
+};
+
+// Reader of an image in memory.
+class mat_tile_reader : public tile_reader
+{
+public:
+    explicit mat_tile_reader( const cv::Mat &image ) : image(image) {}
+
+    int rows() const { return image.rows; }
+    int cols() const { return image.cols; }
+
+    void read( int r0, int c0, int h, int w, unsigned char *pixels )
+    {
+        for ( int r = 0; r < h; r++ )
+        {
+            memcpy(pixels + r * w, image.ptr<unsigned char>(r0 + r) + c0, w);
+        }
+    }
+
+private:
+    const cv::Mat &image;
+};
+
+// Reader of the binarized pixels of another reader: 255 if greater than
+// 'threshold', 0 otherwise (as cv::threshold() with cv::THRESH_BINARY).
+class threshold_tile_reader : public tile_reader
+{
+public:
+    threshold_tile_reader( tile_reader &reader, unsigned char threshold ) : reader(reader), threshold(threshold) {}
+
+    int rows() const { return reader.rows(); }
+    int cols() const { return reader.cols(); }
+
+    void read( int r0, int c0, int h, int w, unsigned char *pixels )
+    {
+        reader.read(r0, c0, h, w, pixels);
+        for ( int k = 0; k < h * w; k++ )
+        {
+            pixels[k] = pixels[k] > threshold ? 255 : 0;
+        }
+    }
+
+private:
+    tile_reader &reader;
+    unsigned char threshold;
+};
+
+// Capacities of an image energy (see build_grid_graph() in image_graph.h for
+// the requirements on 'Energy'), read from a tile_reader.
+template <typename captype, typename tcaptype, typename Energy>
+class energy_tile_source : public GridTileSource<captype, tcaptype>
+{
+public:
+    energy_tile_source( tile_reader &reader, const Energy &energy ) : reader(reader), energy(energy) {}
+
+    void read( int x0, int y0, int w, int h, tcaptype *source, tcaptype *sink,
+               captype *right, captype *right_rev, captype *down, captype *down_rev )
+    {
+        // the block and its right column and lower row of neighbours, if any
+        const int bw = x0 + w < reader.cols() ? w + 1 : w;
+        const int bh = y0 + h < reader.rows() ? h + 1 : h;
+        pixels.resize(bw * bh);
+        reader.read(y0, x0, bh, bw, &pixels[0]);
+
+        for ( int r = 0; r < h; r++ )
+        {
+            for ( int c = 0; c < w; c++ )
+            {
+                const int k = r * w + c;
+                const unsigned char w_n = pixels[r * bw + c];
+                source[k] = energy.source(w_n);
+                sink[k] = energy.sink(w_n);
+                right[k] = right_rev[k] = down[k] = down_rev[k] = 0;
+                if ( c + 1 < bw )
+                {
+                    const unsigned char w_m = pixels[r * bw + c + 1];
+                    right[k] = energy.pairwise(w_n, w_m);
+                    right_rev[k] = energy.pairwise(w_m, w_n);
+                }
+                if ( r + 1 < bh )
+                {
+                    const unsigned char w_m = pixels[(r + 1) * bw + c];
+                    down[k] = energy.pairwise(w_n, w_m);
+                    down_rev[k] = energy.pairwise(w_m, w_n);
+                }
+            }
+        }
+    }
+
+private:
+    tile_reader &reader;
+    const Energy &energy;
+    std::vector<unsigned char> pixels;
+};
+
+// Write the segmentation of a solved TiledGridGraph to a binary PGM file,
+// one tile at a time: 'source_value' for the pixels in the SOURCE segment,
+// 'sink_value' for the others. Return false if the file cannot be written.
+template <typename GraphType>
+bool save_tiled_segmentation( GraphType &g, const std::string &file_name,
+                              unsigned char source_value, unsigned char sink_value )
+{
+    FILE *file = fopen(file_name.c_str(), "wb");
+    if ( !file ) return false;
+
+    const int rows = g.get_height();
+    const int cols = g.get_width();
+    const int tile = g.get_tile_size();
+    fprintf(file, "P5\n%d %d\n255\n", cols, rows);
+    const tiledgraph_off_t data_offset = ftell(file);
+
+    bool ok = true;
+    std::vector<unsigned char> row(tile);
+    for ( int r0 = 0; r0 < rows; r0 += tile )
+    {
+        for ( int c0 = 0; c0 < cols; c0 += tile )
+        {
+            const int h = std::min(tile, rows - r0);
+            const int w = std::min(tile, cols - c0);
+            for ( int r = r0; r < r0 + h; r++ )
+            {
+                for ( int c = 0; c < w; c++ )
+                {
+                    row[c] = g.what_segment(c0 + c, r) == GraphType::SOURCE ? source_value : sink_value;
+                }
+                ok = ok && TILEDGRAPH_FSEEK(file, data_offset + (tiledgraph_off_t)r * cols + c0, SEEK_SET) == 0
+                        && fwrite(&row[0], 1, w, file) == (size_t)w;
+            }
+        }
+    }
+
+    return fclose(file) == 0 && ok;
+}
+
+#endif